@@ -0,0 +1,107 @@
+#include <stdlib.h>
+
+#include "arena.h"
+#include "log.h"
+#include "mem.h"
+
+#define ALIGN_UP(n) (((n) + ARENA_ALIGNMENT - 1) & ~(size_t) (ARENA_ALIGNMENT - 1))
+
+static arena_block *new_block(size_t size);
+
+arena *arena_init(arena *a, size_t block_size)
+{
+	ASSERT_ERROR (a, "Argument a is NULL!");
+	a->first = NULL;
+	a->current = NULL;
+	a->block_size = block_size ? ALIGN_UP(block_size) : ARENA_DEFAULT_BLOCK_SIZE;
+	return a;
+}
+
+void *arena_alloc(arena *a, size_t size)
+{
+	arena_block *b;
+	void *p;
+
+	size = ALIGN_UP(size ? size : 1);
+
+	// continue with the blocks kept by arena_reset before allocating new ones
+	while (a->current && a->current->used + size > a->current->size && a->current->next) {
+		a->current = a->current->next;
+		a->current->used = 0;
+	}
+
+	if (!a->current || a->current->used + size > a->current->size) {
+		b = new_block(size > a->block_size ? size : a->block_size);
+		if (a->current) {
+			b->next = a->current->next;
+			a->current->next = b;
+		} else {
+			a->first = b;
+		}
+		a->current = b;
+	}
+
+	p = (char *) a->current + ALIGN_UP(sizeof (arena_block)) + a->current->used;
+	a->current->used += size;
+	return p;
+}
+
+void arena_reset(arena *a)
+{
+	a->current = a->first;
+	if (a->current)
+		a->current->used = 0;
+}
+
+void arena_free(arena *a)
+{
+	arena_block *b;
+
+	while (a->first) {
+		b = a->first;
+		a->first = b->next;
+		mem_free(MEM_ARENA, b, ALIGN_UP(sizeof (arena_block)) + b->size);
+	}
+	a->current = NULL;
+}
+
+pool *pool_init(pool *p, arena *memory, size_t elem_size)
+{
+	ASSERT_ERROR (p && memory, "Argument p or memory is NULL!");
+	p->memory = memory;
+	p->free_list = NULL;
+	p->elem_size = elem_size < sizeof (void *) ? sizeof (void *) : elem_size;
+	return p;
+}
+
+void *pool_alloc(pool *p)
+{
+	void *elem = p->free_list;
+
+	if (!elem)
+		return arena_alloc(p->memory, p->elem_size);
+	p->free_list = *(void **) elem;
+	return elem;
+}
+
+void pool_release(pool *p, void *elem)
+{
+	*(void **) elem = p->free_list;
+	p->free_list = elem;
+}
+
+void pool_reset(pool *p)
+{
+	p->free_list = NULL;
+}
+
+static arena_block *new_block(size_t size)
+{
+	arena_block *b = mem_alloc(MEM_ARENA, ALIGN_UP(sizeof (arena_block)) + size);
+
+	ASSERT_ERROR (b, "malloc returned NULL!");
+	b->next = NULL;
+	b->size = size;
+	b->used = 0;
+	return b;
+}
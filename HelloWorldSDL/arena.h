@@ -0,0 +1,94 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#include "types.h"
+
+#define ARENA_ALIGNMENT 16
+#define ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+
+typedef struct arena_block {
+	struct arena_block *next; /* next block to use once this one is full */
+	size_t size; /* usable bytes after the header */
+	size_t used; /* bytes handed out since the last reset */
+} arena_block;
+
+/// <summary>
+/// Bump allocator. Allocations are never freed one by one, arena_reset releases all
+/// of them at once and keeps the blocks for the next round of allocations.
+/// </summary>
+typedef struct {
+	arena_block *first; /* all blocks in allocation order */
+	arena_block *current; /* block allocations are taken from */
+	size_t block_size; /* usable bytes of a new block, bigger allocations get a block of their own size */
+} arena;
+
+/// <summary>
+/// Free list of equally sized elements. Released elements are reused before new ones
+/// are taken from the arena, which owns the memory of all elements.
+/// </summary>
+typedef struct {
+	arena *memory; /* where new elements come from */
+	void *free_list; /* released elements, each starting with a pointer to the next one */
+	size_t elem_size; /* at least sizeof (void *) */
+} pool;
+
+/// <summary>
+/// Initialize an empty arena. No memory is allocated before the first arena_alloc.
+/// </summary>
+/// <param name="a">arena to initialize</param>
+/// <param name="block_size">usable bytes per block, 0 for ARENA_DEFAULT_BLOCK_SIZE</param>
+/// <returns>a</returns>
+arena *arena_init(arena *a, size_t block_size);
+
+/// <summary>
+/// Allocate memory aligned to ARENA_ALIGNMENT. Exits if no memory is left.
+/// </summary>
+/// <param name="a">arena</param>
+/// <param name="size">bytes to allocate</param>
+/// <returns>uninitialized memory, valid until the next arena_reset or arena_free</returns>
+void *arena_alloc(arena *a, size_t size);
+
+/// <summary>
+/// Release all allocations at once. Takes constant time, the blocks are kept for reuse.
+/// </summary>
+/// <param name="a">arena</param>
+void arena_reset(arena *a);
+
+/// <summary>
+/// Return all blocks to the system
+/// </summary>
+/// <param name="a">arena</param>
+void arena_free(arena *a);
+
+/// <summary>
+/// Initialize an empty pool
+/// </summary>
+/// <param name="p">pool to initialize</param>
+/// <param name="memory">arena the elements are allocated from</param>
+/// <param name="elem_size">bytes per element</param>
+/// <returns>p</returns>
+pool *pool_init(pool *p, arena *memory, size_t elem_size);
+
+/// <summary>
+/// Take an element from the free list or from the arena if the list is empty
+/// </summary>
+/// <param name="p">pool</param>
+/// <returns>uninitialized element</returns>
+void *pool_alloc(pool *p);
+
+/// <summary>
+/// Put an element back on the free list
+/// </summary>
+/// <param name="p">pool the element was allocated from</param>
+/// <param name="elem">element, must not be used afterwards</param>
+void pool_release(pool *p, void *elem);
+
+/// <summary>
+/// Forget all released elements. Has to be called when the arena of the pool is reset.
+/// </summary>
+/// <param name="p">pool</param>
+void pool_reset(pool *p);
+
+#endif
@@ -0,0 +1,155 @@
+#include "attacks.h"
+#include "platform.h"
+
+#define ROOK_TABLE_SIZE 102400 /* sum of 2^(mask squares) over all squares */
+#define BISHOP_TABLE_SIZE 5248
+
+slider_attacks rook_slider_attacks[SQUARE_NUM];
+slider_attacks bishop_slider_attacks[SQUARE_NUM];
+bool attacks_use_pext;
+
+// Squares reached by a step of (dx,dy) from square, empty if the step leaves the board.
+// The & 63 only keeps the shift valid for steps which are discarded anyway.
+#define STEP(square, dx, dy) \
+	((SQUARE_X(square) + (dx) >= 0 && SQUARE_X(square) + (dx) < 8 && SQUARE_Y(square) + (dy) >= 0 && SQUARE_Y(square) + (dy) < 8) \
+		? SQUARE_BB(((square) + (dx) + 8 * (dy)) & 63) : BB_EMPTY)
+
+#define KNIGHT_STEPS(square) \
+	(STEP(square, 1, 2) | STEP(square, -1, 2) | STEP(square, 1, -2) | STEP(square, -1, -2) \
+	| STEP(square, 2, 1) | STEP(square, -2, 1) | STEP(square, 2, -1) | STEP(square, -2, -1))
+#define KING_STEPS(square) \
+	(STEP(square, 1, 0) | STEP(square, -1, 0) | STEP(square, 0, 1) | STEP(square, 0, -1) \
+	| STEP(square, 1, 1) | STEP(square, -1, 1) | STEP(square, 1, -1) | STEP(square, -1, -1))
+#define WHITE_PAWN_STEPS(square) (STEP(square, 1, 1) | STEP(square, -1, 1))
+#define BLACK_PAWN_STEPS(square) (STEP(square, 1, -1) | STEP(square, -1, -1))
+
+// expands to the initializer f(0), f(1), ..., f(63)
+#define RANK_OF(f, y) f(8 * (y) + 0), f(8 * (y) + 1), f(8 * (y) + 2), f(8 * (y) + 3), \
+	f(8 * (y) + 4), f(8 * (y) + 5), f(8 * (y) + 6), f(8 * (y) + 7)
+#define BOARD_OF(f) RANK_OF(f, 0), RANK_OF(f, 1), RANK_OF(f, 2), RANK_OF(f, 3), \
+	RANK_OF(f, 4), RANK_OF(f, 5), RANK_OF(f, 6), RANK_OF(f, 7)
+
+const bitboard knight_attack_table[SQUARE_NUM] = { BOARD_OF(KNIGHT_STEPS) };
+const bitboard king_attack_table[SQUARE_NUM] = { BOARD_OF(KING_STEPS) };
+const bitboard pawn_attack_table[2][SQUARE_NUM] = { { BOARD_OF(WHITE_PAWN_STEPS) }, { BOARD_OF(BLACK_PAWN_STEPS) } };
+
+static bitboard rook_magic_table[ROOK_TABLE_SIZE];
+static bitboard rook_pext_table[ROOK_TABLE_SIZE];
+static bitboard bishop_magic_table[BISHOP_TABLE_SIZE];
+static bitboard bishop_pext_table[BISHOP_TABLE_SIZE];
+static bool initialized;
+
+static const i32 rook_directions[4][2] = { { 0, 1 }, { 0, -1 }, { 1, 0 }, { -1, 0 } };
+static const i32 bishop_directions[4][2] = { { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 } };
+
+// found by trying sparse random numbers until no two subsets of a mask with different attacks collide
+static const u64 rook_magics[SQUARE_NUM] = {
+	0x008000908064C000ULL, 0x0040200040001000ULL, 0x0180100080A0010AULL, 0x8880041000800800ULL,
+	0x1200100201200804ULL, 0x0200020004011008ULL, 0x2180010000800600ULL, 0x0200005088210204ULL,
+	0x0400800040008021ULL, 0x0400400020005000ULL, 0x8240801000200080ULL, 0x8611001004200900ULL,
+	0x008180800C001800ULL, 0x0100800200800400ULL, 0x0A02000102000408ULL, 0x8020802300104280ULL,
+	0x0080004000402000ULL, 0xE010104000402000ULL, 0x0800808010002000ULL, 0xA280210008100100ULL,
+	0x0001818014000800ULL, 0xA002010100080400ULL, 0x0080240001020870ULL, 0x0001020004048845ULL,
+	0x0081826280004004ULL, 0x2020810900284000ULL, 0x0200100080802000ULL, 0x0200080080100080ULL,
+	0x8083080100100500ULL, 0x4406000901000400ULL, 0x0005020080800100ULL, 0x0090204200008114ULL,
+	0x0010400094800420ULL, 0x0900804000802002ULL, 0x0201001841002000ULL, 0x4100080080801000ULL,
+	0x4540040080800800ULL, 0x0002001004040020ULL, 0x0281195814001002ULL, 0x1240800040800100ULL,
+	0x0880042000524004ULL, 0x02C080410206002CULL, 0x0801200241050010ULL, 0x8400080010008080ULL,
+	0x0008000500090010ULL, 0x0082009084020008ULL, 0x4012000108020004ULL, 0x9000104D08860004ULL,
+	0x2004204114800100ULL, 0x0148802112400300ULL, 0x0202842000100880ULL, 0x001B080080900080ULL,
+	0x001A002008100600ULL, 0x0004008004020080ULL, 0x5181000600040300ULL, 0x0000044401128A00ULL,
+	0x8044110480002441ULL, 0x2008110084402202ULL, 0x90806005090010C1ULL, 0x000420310A004A42ULL,
+	0x0023001004020801ULL, 0x0882001008040102ULL, 0x000230088118020CULL, 0x0000019025040042ULL
+};
+
+static const u64 bishop_magics[SQUARE_NUM] = {
+	0x0045010808008680ULL, 0x2002080204004898ULL, 0x0210009A10400006ULL, 0x0824050200810200ULL,
+	0x0006061105004090ULL, 0x00010108C0000000ULL, 0x0814040282104004ULL, 0x0012012201106800ULL,
+	0x10823014100C1040ULL, 0x0080C2088802808CULL, 0x0281108410404000ULL, 0x0101212041826200ULL,
+	0x0020141028221058ULL, 0x2201020202200202ULL, 0x000082A801482000ULL, 0x0000008401411044ULL,
+	0x0007103014300404ULL, 0x0002091110010100ULL, 0x42140012040C0808ULL, 0x0800808802004020ULL,
+	0x90C4004210140000ULL, 0x0800200900A01000ULL, 0x00D0400201108810ULL, 0x80820183814412A0ULL,
+	0x00A01008202202B4ULL, 0x01C2021A09500402ULL, 0x0084440208042400ULL, 0x800400400C090100ULL,
+	0xBA10040010802100ULL, 0xD182009006005000ULL, 0x5011021001009004ULL, 0x0020420200510400ULL,
+	0x0292104000468800ULL, 0x00043009091C0500ULL, 0x0280441000020025ULL, 0x0042820080080080ULL,
+	0x0440101010010040ULL, 0x1000900100808080ULL, 0x0108108120089800ULL, 0x0044010200012682ULL,
+	0xC002500420900400ULL, 0x0040482210710800ULL, 0x0002060024000200ULL, 0x0281020A44000800ULL,
+	0xA0021200A4000200ULL, 0x0001301000840840ULL, 0x2868500108444220ULL, 0x0004111041000200ULL,
+	0x8044020842080200ULL, 0x0000220104210200ULL, 0x0000021201044000ULL, 0x0000280884040028ULL,
+	0x4012114010858003ULL, 0x0000081004082B88ULL, 0x3892700508208002ULL, 0x00220A041B060400ULL,
+	0x0812020284014881ULL, 0x010434A282103100ULL, 0x0490400824020800ULL, 0x4A20002C00208800ULL,
+	0x000000A011020200ULL, 0x4002940A02482202ULL, 0x5100100202140406ULL, 0x02102000840540C1ULL
+};
+
+static bitboard ray_attacks(u32 square, bitboard occupied, const i32 directions[4][2]);
+static void init_slider(slider_attacks *a, u32 square, u64 magic, const i32 directions[4][2], bitboard *magic_table, bitboard *pext_table);
+
+void attacks_init(void)
+{
+	bitboard *rook_magic = rook_magic_table, *rook_pext = rook_pext_table;
+	bitboard *bishop_magic = bishop_magic_table, *bishop_pext = bishop_pext_table;
+	u32 square;
+
+	if (initialized)
+		return;
+
+	for (square = 0; square < SQUARE_NUM; ++square) {
+		init_slider(&rook_slider_attacks[square], square, rook_magics[square], rook_directions, rook_magic, rook_pext);
+		rook_magic += (u32) 1 << (64 - rook_slider_attacks[square].shift);
+		rook_pext += (u32) 1 << (64 - rook_slider_attacks[square].shift);
+		init_slider(&bishop_slider_attacks[square], square, bishop_magics[square], bishop_directions, bishop_magic, bishop_pext);
+		bishop_magic += (u32) 1 << (64 - bishop_slider_attacks[square].shift);
+		bishop_pext += (u32) 1 << (64 - bishop_slider_attacks[square].shift);
+	}
+
+	attacks_set_pext(true);
+	initialized = true;
+}
+
+bool attacks_set_pext(bool enable)
+{
+#if defined BB_HAVE_PEXT
+	attacks_use_pext = enable && cpu_has_fast_pext();
+#else
+	attacks_use_pext = false;
+#endif
+	return attacks_use_pext;
+}
+
+// attacks walking each ray until the first occupied square, only used to fill the tables
+static bitboard ray_attacks(u32 square, bitboard occupied, const i32 directions[4][2])
+{
+	bitboard targets = BB_EMPTY, ray;
+	u32 i;
+
+	for (i = 0; i < 4; ++i) {
+		for (ray = bb_shift(SQUARE_BB(square), directions[i][0], directions[i][1]); ray; ray = bb_shift(ray, directions[i][0], directions[i][1])) {
+			targets |= ray;
+			if (ray & occupied)
+				break;
+		}
+	}
+	return targets;
+}
+
+static void init_slider(slider_attacks *a, u32 square, u64 magic, const i32 directions[4][2], bitboard *magic_table, bitboard *pext_table)
+{
+	bitboard edges, subset = BB_EMPTY;
+	u64 i = 0;
+
+	// the last square of a ray is attacked whether it is occupied or not, unless the slider stands on that edge
+	edges = ((BB_RANK_1 | BB_RANK_8) & ~(BB_RANK_1 << (8 * SQUARE_Y(square))))
+		| ((BB_FILE_A | BB_FILE_H) & ~(BB_FILE_A << SQUARE_X(square)));
+	a->mask = ray_attacks(square, BB_EMPTY, directions) & ~edges;
+	a->magic = magic;
+	a->shift = 64 - bb_popcount(a->mask);
+	a->magic_attacks = magic_table;
+	a->pext_attacks = pext_table;
+
+	// the carry rippler visits the subsets of mask in the order of their PEXT index
+	do {
+		magic_table[(subset * magic) >> a->shift] = ray_attacks(square, subset, directions);
+		pext_table[i++] = magic_table[(subset * magic) >> a->shift];
+		subset = (subset - a->mask) & a->mask;
+	} while (subset);
+}
@@ -0,0 +1,94 @@
+#ifndef ATTACKS_H
+#define ATTACKS_H
+
+#include "bitboard.h"
+#include "types.h"
+
+/// <summary>
+/// Attack lookup of a sliding piece on one square. Only the occupancy of the squares in mask
+/// changes the attacks, and every subset of mask maps to its own table index, either by a
+/// multiplication with a magic number or by the PEXT instruction.
+/// </summary>
+typedef struct {
+	bitboard mask; /* squares on the rays, without the last square of each ray */
+	u64 magic; /* (occupied & mask) * magic >> shift is a unique index for every subset of mask */
+	u32 shift; /* 64 - number of squares in mask */
+	const bitboard *magic_attacks; /* attacks by magic index */
+	const bitboard *pext_attacks; /* attacks by PEXT index */
+} slider_attacks;
+
+/// <summary>
+/// Squares attacked by a knight, king or pawn on each square. Pawns are indexed by piece_color first.
+/// These are constant initializers generated by the preprocessor and need no attacks_init.
+/// </summary>
+extern const bitboard knight_attack_table[SQUARE_NUM];
+extern const bitboard king_attack_table[SQUARE_NUM];
+extern const bitboard pawn_attack_table[2][SQUARE_NUM];
+
+extern slider_attacks rook_slider_attacks[SQUARE_NUM];
+extern slider_attacks bishop_slider_attacks[SQUARE_NUM];
+
+/// <summary>
+/// true if lookups use PEXT instead of magic multiplication
+/// </summary>
+extern bool attacks_use_pext;
+
+/// <summary>
+/// Fill the attack tables. Does nothing if they are already filled. init_chess and
+/// chess_state_from_fen call it, so it runs before any game state exists. Not thread safe.
+/// </summary>
+void attacks_init(void);
+
+/// <summary>
+/// Select the lookup method. Must not be called while other threads generate moves.
+/// </summary>
+/// <param name="enable">true to use PEXT</param>
+/// <returns>true if PEXT is used, false if it was disabled or the processor lacks a fast PEXT</returns>
+bool attacks_set_pext(bool enable);
+
+/// <summary>
+/// Squares attacked by a slider, including the first occupied square of each ray
+/// </summary>
+static inline bitboard slider_attacks_lookup(const slider_attacks *a, bitboard occupied)
+{
+#if defined BB_HAVE_PEXT
+	if (attacks_use_pext)
+		return a->pext_attacks[bb_pext(occupied, a->mask)];
+#endif
+	return a->magic_attacks[((occupied & a->mask) * a->magic) >> a->shift];
+}
+
+static inline bitboard knight_attacks(u32 square)
+{
+	return knight_attack_table[square];
+}
+
+static inline bitboard king_attacks(u32 square)
+{
+	return king_attack_table[square];
+}
+
+/// <summary>
+/// Squares a pawn of color (WHITE or BLACK) on square captures on
+/// </summary>
+static inline bitboard pawn_attacks(u32 color, u32 square)
+{
+	return pawn_attack_table[color][square];
+}
+
+static inline bitboard rook_attacks(u32 square, bitboard occupied)
+{
+	return slider_attacks_lookup(&rook_slider_attacks[square], occupied);
+}
+
+static inline bitboard bishop_attacks(u32 square, bitboard occupied)
+{
+	return slider_attacks_lookup(&bishop_slider_attacks[square], occupied);
+}
+
+static inline bitboard queen_attacks(u32 square, bitboard occupied)
+{
+	return rook_attacks(square, occupied) | bishop_attacks(square, occupied);
+}
+
+#endif
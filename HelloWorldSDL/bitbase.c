@@ -0,0 +1,325 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "attacks.h"
+#include "bitbase.h"
+#include "log.h"
+#include "mem.h"
+#include "platform.h"
+
+#define BITBASE_MAGIC "CSBB0001" /* file header, the version changes with the layout */
+#define BITBASE_HEADER_SIZE 8
+#define BITBASE_FILE_SIZE (BITBASE_HEADER_SIZE + BITBASE_MAX * BITBASE_BYTES)
+
+/* generation state of a position */
+enum {
+	POSITION_INVALID,
+	POSITION_UNKNOWN, /* not won so far, a draw once nothing changes anymore */
+	POSITION_WIN
+};
+
+/// one endgame being generated, the strong side is white and moves up the board
+typedef struct {
+	bitbase_endgame endgame;
+	piece_type piece;
+	const u8 *old_state; /* POSITION_* of the last pass */
+	u8 *new_state; /* written by the current pass */
+	u32 thread_num;
+	volatile u64 changed; /* positions won in the current pass */
+} bitbase_generator;
+
+typedef struct {
+	bitbase_generator *g;
+	u32 id;
+} bitbase_worker;
+
+static const u8 *tables[BITBASE_MAX]; /* NULL before bitbases_init */
+static const void *mapping; /* file mapped by bitbases_init */
+static u64 mapping_size;
+static u8 *generated; /* tables generated in memory, if the file could not be mapped */
+
+static const piece_type endgame_pieces[BITBASE_MAX] = { QUEEN, ROOK, PAWN };
+
+static void generate(u8 *table, bitbase_endgame endgame, u32 thread_num);
+static void run_pass(bitbase_generator *g, thread_func pass);
+static void initialize_slice(void *arg);
+static void update_slice(void *arg);
+static u8 classify(const bitbase_generator *g, u32 index);
+static bitboard piece_attacks(piece_type t, u32 square, bitboard occupied);
+static bool lookup(const u8 *table, u32 index);
+
+static inline u32 bitbase_index(u32 weak_to_move, u32 strong_king, u32 weak_king, u32 piece)
+{
+	return ((weak_to_move * SQUARE_NUM + strong_king) * SQUARE_NUM + weak_king) * SQUARE_NUM + piece;
+}
+
+bool bitbases_init(const char *path, u32 thread_num)
+{
+	FILE *f;
+	bool ok;
+	u32 i;
+
+	attacks_init();
+	bitbases_free();
+	mapping = file_map(path, &mapping_size);
+	if (mapping && mapping_size == BITBASE_FILE_SIZE && !memcmp(mapping, BITBASE_MAGIC, BITBASE_HEADER_SIZE)) {
+		for (i = 0; i < BITBASE_MAX; ++i)
+			tables[i] = (const u8 *) mapping + BITBASE_HEADER_SIZE + (u64) i * BITBASE_BYTES;
+		return true;
+	}
+	file_unmap(mapping, mapping_size);
+	mapping = NULL;
+
+	LOG_INFO ("Generating bitbases on %u threads", thread_num);
+	generated = mem_calloc(MEM_BITBASE, BITBASE_MAX, BITBASE_BYTES);
+	ASSERT_ERROR (generated, "Could not allocate the bitbases");
+	for (i = 0; i < BITBASE_MAX; ++i) {
+		generate(generated + (u64) i * BITBASE_BYTES, (bitbase_endgame) i, thread_num ? thread_num : 1);
+		tables[i] = generated + (u64) i * BITBASE_BYTES;
+	}
+
+	f = fopen(path, "wb");
+	if (!f) {
+		LOG_WARNING ("Could not save the bitbases to %s", path);
+		return false;
+	}
+	fwrite(BITBASE_MAGIC, BITBASE_HEADER_SIZE, 1, f);
+	fwrite(generated, BITBASE_BYTES, BITBASE_MAX, f);
+	ok = !ferror(f);
+	ok &= !fclose(f);
+	ASSERT_WARNING (ok, "Could not save the bitbases to %s", path);
+	return ok;
+}
+
+void bitbases_free(void)
+{
+	memset(tables, 0, sizeof (tables));
+	file_unmap(mapping, mapping_size);
+	mapping = NULL;
+	mapping_size = 0;
+	mem_free(MEM_BITBASE, generated, BITBASE_MAX * BITBASE_BYTES);
+	generated = NULL;
+}
+
+bitbase_result bitbase_probe(const chess_state *c, piece_color *winner)
+{
+	piece_color strong, weak;
+	u32 strong_king, weak_king, piece, flip, i;
+
+	if (bb_popcount(c->occupied_all) > 3)
+		return BITBASE_NONE;
+	// neither side can mate with a lone minor piece
+	if (bb_popcount(c->occupied_all) == 2
+		|| (c->pieces[WHITE][KNIGHT] | c->pieces[WHITE][BISHOP] | c->pieces[BLACK][KNIGHT] | c->pieces[BLACK][BISHOP]))
+	{
+		return BITBASE_DRAW;
+	}
+	if (c->can_castle[LEFT][WHITE] || c->can_castle[RIGHT][WHITE] || c->can_castle[LEFT][BLACK] || c->can_castle[RIGHT][BLACK])
+		return BITBASE_NONE;
+
+	strong = bb_popcount(c->occupied[WHITE]) == 2 ? WHITE : BLACK;
+	weak = (strong == WHITE) ? BLACK : WHITE;
+	for (i = 0; i < BITBASE_MAX && !c->pieces[strong][endgame_pieces[i]]; ++i);
+	if (i == BITBASE_MAX || !tables[i])
+		return BITBASE_NONE;
+
+	// the tables are made for white, black moves down the board
+	flip = (strong == WHITE) ? 0 : 56;
+	strong_king = bb_lsb(c->pieces[strong][KING]) ^ flip;
+	weak_king = bb_lsb(c->pieces[weak][KING]) ^ flip;
+	piece = bb_lsb(c->pieces[strong][endgame_pieces[i]]) ^ flip;
+	*winner = strong;
+	return lookup(tables[i], bitbase_index(c->active_color != strong, strong_king, weak_king, piece)) ? BITBASE_WIN : BITBASE_DRAW;
+}
+
+bool bitbase_adjudicate(chess *c)
+{
+	piece_color winner;
+
+	switch (bitbase_probe(&c->current_state, &winner)) {
+	case BITBASE_WIN:
+		c->winner = winner;
+		c->is_draw = false;
+		break;
+	case BITBASE_DRAW:
+		c->is_draw = true;
+		break;
+	default:
+		return false;
+	}
+	c->is_game_over = true;
+	return true;
+}
+
+// repeats passes over all positions until no further position is won, the rest are draws
+static void generate(u8 *table, bitbase_endgame endgame, u32 thread_num)
+{
+	bitbase_generator g = { endgame, endgame_pieces[endgame], NULL, NULL, thread_num, 0 };
+	u8 *state[2];
+	u32 i, pass = 0;
+	u64 start = time_now_ns(), wins = 0;
+
+	state[0] = mem_alloc(MEM_BITBASE, BITBASE_POSITIONS);
+	state[1] = mem_alloc(MEM_BITBASE, BITBASE_POSITIONS);
+	ASSERT_ERROR (state[0] && state[1], "Could not allocate the bitbase generator");
+
+	g.new_state = state[0];
+	run_pass(&g, initialize_slice);
+	do {
+		// every position depends on the last pass only, so the threads need no locking
+		g.old_state = state[pass & 1];
+		g.new_state = state[~pass & 1];
+		memcpy(g.new_state, g.old_state, BITBASE_POSITIONS);
+		g.changed = 0;
+		run_pass(&g, update_slice);
+		++pass;
+	} while (g.changed);
+
+	memset(table, 0, BITBASE_BYTES);
+	for (i = 0; i < BITBASE_POSITIONS; ++i) {
+		if (g.new_state[i] == POSITION_WIN) {
+			table[i / 8] |= (u8) (1 << (i % 8));
+			++wins;
+		}
+	}
+	LOG_INFO ("Generated bitbase %u in %u passes and %llu ms, %llu wins", endgame, pass,
+		(time_now_ns() - start) / 1000000, wins);
+	mem_free(MEM_BITBASE, state[0], BITBASE_POSITIONS);
+	mem_free(MEM_BITBASE, state[1], BITBASE_POSITIONS);
+}
+
+// runs pass on every slice of the positions, the calling thread takes the first one
+static void run_pass(bitbase_generator *g, thread_func pass)
+{
+	bitbase_worker workers[64];
+	platform_thread *threads[64];
+	u32 i, thread_num = g->thread_num < 64 ? g->thread_num : 64;
+
+	for (i = 0; i < thread_num; ++i)
+		workers[i] = (bitbase_worker) { g, i };
+	g->thread_num = thread_num;
+	for (i = 1; i < thread_num; ++i)
+		threads[i] = thread_start(pass, &workers[i]);
+	pass(&workers[0]);
+	// slices of threads which could not be started are done here
+	for (i = 1; i < thread_num; ++i) {
+		if (threads[i])
+			thread_join(threads[i]);
+		else
+			pass(&workers[i]);
+	}
+}
+
+// marks the positions which cannot occur, and the mates
+static void initialize_slice(void *arg)
+{
+	bitbase_worker *w = arg;
+	bitbase_generator *g = w->g;
+	u32 index, end = (u32) ((u64) BITBASE_POSITIONS * (w->id + 1) / g->thread_num);
+	u32 weak_to_move, strong_king, weak_king, piece;
+	bitboard occupied;
+
+	for (index = (u32) ((u64) BITBASE_POSITIONS * w->id / g->thread_num); index < end; ++index) {
+		piece = index % SQUARE_NUM;
+		weak_king = index / SQUARE_NUM % SQUARE_NUM;
+		strong_king = index / SQUARE_NUM / SQUARE_NUM % SQUARE_NUM;
+		weak_to_move = index / SQUARE_NUM / SQUARE_NUM / SQUARE_NUM;
+		occupied = SQUARE_BB(strong_king) | SQUARE_BB(weak_king) | SQUARE_BB(piece);
+
+		g->new_state[index] = POSITION_UNKNOWN;
+		if (bb_popcount(occupied) != 3 || (king_attacks(strong_king) & SQUARE_BB(weak_king))
+			|| (g->piece == PAWN && (SQUARE_Y(piece) == 0 || SQUARE_Y(piece) == 7))
+			|| (!weak_to_move && (piece_attacks(g->piece, piece, occupied) & SQUARE_BB(weak_king))))
+		{
+			g->new_state[index] = POSITION_INVALID;
+		}
+	}
+}
+
+static void update_slice(void *arg)
+{
+	bitbase_worker *w = arg;
+	bitbase_generator *g = w->g;
+	u32 index, end = (u32) ((u64) BITBASE_POSITIONS * (w->id + 1) / g->thread_num);
+	u64 changed = 0;
+
+	for (index = (u32) ((u64) BITBASE_POSITIONS * w->id / g->thread_num); index < end; ++index) {
+		if (g->old_state[index] != POSITION_UNKNOWN)
+			continue;
+		g->new_state[index] = classify(g, index);
+		changed += g->new_state[index] == POSITION_WIN;
+	}
+	atomic_add_u64(&g->changed, changed);
+}
+
+// a position is won if the strong side has a move to a won position, or every move of the weak side leads to one
+static u8 classify(const bitbase_generator *g, u32 index)
+{
+	u32 piece = index % SQUARE_NUM;
+	u32 weak_king = index / SQUARE_NUM % SQUARE_NUM;
+	u32 strong_king = index / SQUARE_NUM / SQUARE_NUM % SQUARE_NUM;
+	u32 weak_to_move = index / SQUARE_NUM / SQUARE_NUM / SQUARE_NUM;
+	bitboard occupied = SQUARE_BB(strong_king) | SQUARE_BB(weak_king) | SQUARE_BB(piece);
+	bitboard targets, attacked;
+	u32 to;
+
+	if (weak_to_move) {
+		// the king does not block a slider's attack on the squares behind it
+		attacked = king_attacks(strong_king) | piece_attacks(g->piece, piece, occupied & ~SQUARE_BB(weak_king));
+		targets = king_attacks(weak_king) & ~attacked;
+		if (!targets)
+			return (attacked & SQUARE_BB(weak_king)) ? POSITION_WIN : POSITION_UNKNOWN;
+		while (targets) {
+			to = bb_pop_lsb(&targets);
+			// taking the piece leaves bare kings
+			if (to == piece || g->old_state[bitbase_index(0, strong_king, to, piece)] != POSITION_WIN)
+				return POSITION_UNKNOWN;
+		}
+		return POSITION_WIN;
+	}
+
+	targets = king_attacks(strong_king) & ~king_attacks(weak_king) & ~SQUARE_BB(piece);
+	while (targets) {
+		to = bb_pop_lsb(&targets);
+		if (g->old_state[bitbase_index(1, to, weak_king, piece)] == POSITION_WIN)
+			return POSITION_WIN;
+	}
+
+	if (g->piece != PAWN) {
+		targets = piece_attacks(g->piece, piece, occupied) & ~occupied;
+		while (targets) {
+			to = bb_pop_lsb(&targets);
+			if (g->old_state[bitbase_index(1, strong_king, weak_king, to)] == POSITION_WIN)
+				return POSITION_WIN;
+		}
+		return POSITION_UNKNOWN;
+	}
+
+	// pawn pushes, a promotion to a queen may stalemate where one to a rook wins
+	to = piece + 8;
+	if (occupied & SQUARE_BB(to))
+		return POSITION_UNKNOWN;
+	if (SQUARE_Y(to) == 7) {
+		return (lookup(tables[BITBASE_KQK], bitbase_index(1, strong_king, weak_king, to))
+			|| lookup(tables[BITBASE_KRK], bitbase_index(1, strong_king, weak_king, to))) ? POSITION_WIN : POSITION_UNKNOWN;
+	}
+	if (g->old_state[bitbase_index(1, strong_king, weak_king, to)] == POSITION_WIN)
+		return POSITION_WIN;
+	if (SQUARE_Y(piece) == 1 && !(occupied & SQUARE_BB(to + 8)) && g->old_state[bitbase_index(1, strong_king, weak_king, to + 8)] == POSITION_WIN)
+		return POSITION_WIN;
+	return POSITION_UNKNOWN;
+}
+
+static bitboard piece_attacks(piece_type t, u32 square, bitboard occupied)
+{
+	switch (t) {
+	case QUEEN: return queen_attacks(square, occupied);
+	case ROOK: return rook_attacks(square, occupied);
+	default: return pawn_attacks(WHITE, square);
+	}
+}
+
+static bool lookup(const u8 *table, u32 index)
+{
+	return (table[index / 8] >> (index % 8)) & 1;
+}
@@ -0,0 +1,60 @@
+#ifndef BITBASE_H
+#define BITBASE_H
+
+#include "chess.h"
+#include "types.h"
+
+#ifndef BITBASE_FILE
+#define BITBASE_FILE "./bitbases.bin"
+#endif // BITBASE_FILE
+
+#define BITBASE_POSITIONS (2 * SQUARE_NUM * SQUARE_NUM * SQUARE_NUM) /* side to move, both kings and the piece */
+#define BITBASE_BYTES (BITBASE_POSITIONS / 8) /* one bit per position */
+
+/// <summary>
+/// Endgames of king and one piece against a lone king, in the order they are generated and stored
+/// </summary>
+typedef enum {
+	BITBASE_KQK,
+	BITBASE_KRK,
+	BITBASE_KPK, /* needs KQK and KRK for the promotions */
+	BITBASE_MAX
+} bitbase_endgame;
+
+typedef enum {
+	BITBASE_NONE, /* the position is not covered */
+	BITBASE_DRAW,
+	BITBASE_WIN /* the side with the piece wins */
+} bitbase_result;
+
+/// <summary>
+/// Map the bitbases from path, or generate them by retrograde analysis on thread_num threads and save them
+/// to path if the file is missing or broken. Generation takes a few seconds on one thread. Not thread safe.
+/// </summary>
+/// <param name="path">bitbase file, e.g. BITBASE_FILE</param>
+/// <param name="thread_num">threads generating the bitbases</param>
+/// <returns>false if the bitbases had to be generated and could not be saved, they are usable anyway</returns>
+bool bitbases_init(const char *path, u32 thread_num);
+
+/// <summary>
+/// Release the bitbases, probes find nothing afterwards. Not thread safe.
+/// </summary>
+void bitbases_free(void);
+
+/// <summary>
+/// Look up the outcome of a position with perfect play, ignoring the fifty-move rule. Besides the bitbase
+/// endgames, bare kings and a lone minor piece are known draws.
+/// </summary>
+/// <param name="c">game state</param>
+/// <param name="winner">receives the winning color if the result is BITBASE_WIN</param>
+/// <returns>BITBASE_NONE for other material, castling rights or before bitbases_init</returns>
+bitbase_result bitbase_probe(const chess_state *c, piece_color *winner);
+
+/// <summary>
+/// End a game whose outcome is known from bitbase_probe, so it need not be played out
+/// </summary>
+/// <param name="c">chess struct with current game state</param>
+/// <returns>true if the game was adjudicated and is over now</returns>
+bool bitbase_adjudicate(chess *c);
+
+#endif
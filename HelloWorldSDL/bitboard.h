@@ -0,0 +1,119 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#if defined _MSC_VER
+#include <intrin.h>
+#endif
+
+#if defined _MSC_VER && defined _M_X64
+#include <immintrin.h>
+#define BB_HAVE_PEXT
+#elif (defined __GNUC__ || defined __clang__) && defined __x86_64__
+#define BB_HAVE_PEXT
+#endif
+
+#include "types.h"
+
+/// <summary>
+/// 64 bit set with one bit per board square. Bit (y * 8 + x) is square (x,y),
+/// so bit 0 is a1 (white's queenside rook) and bit 63 is h8.
+/// </summary>
+typedef u64 bitboard;
+
+#define SQUARE_NUM 64
+
+#define SQUARE(x, y) ((y) * 8 + (x))
+#define SQUARE_X(sq) ((sq) & 7)
+#define SQUARE_Y(sq) ((sq) >> 3)
+#define SQUARE_BB(sq) ((bitboard) 1 << (sq))
+
+#define BB_EMPTY ((bitboard) 0)
+#define BB_FILE_A ((bitboard) 0x0101010101010101)
+#define BB_FILE_B (BB_FILE_A << 1)
+#define BB_FILE_G (BB_FILE_A << 6)
+#define BB_FILE_H (BB_FILE_A << 7)
+#define BB_RANK_1 ((bitboard) 0xFF)
+#define BB_RANK_2 (BB_RANK_1 << (8 * 1))
+#define BB_RANK_3 (BB_RANK_1 << (8 * 2))
+#define BB_RANK_6 (BB_RANK_1 << (8 * 5))
+#define BB_RANK_7 (BB_RANK_1 << (8 * 6))
+#define BB_RANK_8 (BB_RANK_1 << (8 * 7))
+
+/// <summary>
+/// Number of set bits
+/// </summary>
+static inline u32 bb_popcount(bitboard b)
+{
+#if defined _MSC_VER && defined _M_X64
+	return (u32) __popcnt64(b);
+#elif defined _MSC_VER
+	return __popcnt((u32) b) + __popcnt((u32) (b >> 32));
+#else
+	return (u32) __builtin_popcountll(b);
+#endif
+}
+
+/// <summary>
+/// Index of the least significant set bit. b must not be empty!
+/// </summary>
+static inline u32 bb_lsb(bitboard b)
+{
+#if defined _MSC_VER && defined _M_X64
+	unsigned long i;
+	_BitScanForward64(&i, b);
+	return (u32) i;
+#elif defined _MSC_VER
+	unsigned long i;
+	if (_BitScanForward(&i, (u32) b))
+		return (u32) i;
+	_BitScanForward(&i, (u32) (b >> 32));
+	return (u32) i + 32;
+#else
+	return (u32) __builtin_ctzll(b);
+#endif
+}
+
+/// <summary>
+/// Removes the least significant set bit from b and returns its index. *b must not be empty!
+/// </summary>
+static inline u32 bb_pop_lsb(bitboard *b)
+{
+	u32 i = bb_lsb(*b);
+	*b &= *b - 1;
+	return i;
+}
+
+#if defined BB_HAVE_PEXT
+/// <summary>
+/// Packs the bits of b selected by mask into the low bits (BMI2 PEXT instruction).
+/// Only call this if cpu_has_fast_pext() returned true!
+/// </summary>
+static inline u64 bb_pext(bitboard b, bitboard mask)
+{
+#if defined _MSC_VER
+	return _pext_u64(b, mask);
+#else
+	// inline assembly, so the rest of the program does not need to be compiled for BMI2
+	u64 r;
+	__asm__ ("pextq %2, %1, %0" : "=r" (r) : "r" (b), "r" (mask));
+	return r;
+#endif
+}
+#endif
+
+/// <summary>
+/// Shifts all squares by (dx,dy). Squares leaving the board are dropped, nothing wraps around. |dx| <= 2.
+/// </summary>
+static inline bitboard bb_shift(bitboard b, i32 dx, i32 dy)
+{
+	if (dx > 0)
+		b &= ~(BB_FILE_H | (dx > 1 ? BB_FILE_G : BB_EMPTY));
+	else if (dx < 0)
+		b &= ~(BB_FILE_A | (dx < -1 ? BB_FILE_B : BB_EMPTY));
+
+	if (dx + 8 * dy > 0)
+		return b << (dx + 8 * dy);
+	return b >> -(dx + 8 * dy);
+}
+
+#endif
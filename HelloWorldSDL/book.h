@@ -0,0 +1,107 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include "chess.h"
+#include "types.h"
+
+#define BOOK_ENTRY_SIZE 16 /* bytes per entry in the file */
+#define BOOK_MAX_MOVES 64 /* book moves of one position considered by book_pick */
+
+/// <summary>
+/// Entry of a book in the Polyglot format. The file holds nothing but the entries, stored big endian and
+/// sorted by key, so books of other programs can be read and books built by book_build used elsewhere.
+/// Moves are encoded like in Polyglot: bits 0-5 target square, 6-11 starting square, 12-14 promotion
+/// (1 knight, 2 bishop, 3 rook, 4 queen), with castling written as the king capturing its rook.
+/// </summary>
+typedef struct {
+	u64 key; /* Polyglot key of the position, see polyglot_key */
+	u16 move; /* move in Polyglot encoding */
+	u16 weight; /* relative frequency of the move, 0 for moves which should not be played */
+	u32 learn; /* unused, kept for the file layout */
+} book_entry;
+
+/// <summary>
+/// Book file mapped into memory. Probing reads the mapping directly and allocates nothing.
+/// </summary>
+typedef struct {
+	const u8 *data; /* the file, entries as stored */
+	u64 size; /* size of the mapping */
+	u64 entry_num;
+} opening_book;
+
+/// <summary>
+/// Move found in a book
+/// </summary>
+typedef struct {
+	move m;
+	u16 weight;
+} book_move;
+
+/// <summary>
+/// Map a book file
+/// </summary>
+/// <param name="b">book to open</param>
+/// <param name="path">book file</param>
+/// <returns>false if the file could not be mapped or its size is no multiple of BOOK_ENTRY_SIZE</returns>
+bool book_open(opening_book *b, const char *path);
+
+/// <summary>
+/// Unmap a book opened by book_open
+/// </summary>
+void book_close(opening_book *b);
+
+/// <summary>
+/// Find the legal book moves of a position by binary search on its key
+/// </summary>
+/// <param name="b">book</param>
+/// <param name="c">position</param>
+/// <param name="moves">receives the moves in the order of the book</param>
+/// <param name="capacity">size of moves</param>
+/// <returns>number of moves stored in moves</returns>
+u32 book_probe(const opening_book *b, const chess_state *c, book_move *moves, u32 capacity);
+
+/// <summary>
+/// Choose a book move with a probability proportional to its weight
+/// </summary>
+/// <param name="b">book</param>
+/// <param name="c">position</param>
+/// <param name="random">random number choosing the move</param>
+/// <returns>MOVE_NONE if the book has no move with a weight above 0 for c</returns>
+move book_pick(const opening_book *b, const chess_state *c, u64 random);
+
+/// <summary>
+/// Compute the key of a position as defined by the Polyglot book format, which uses other random numbers
+/// than chess_state.key. Like there, the en pessant file only counts if a pawn of the side to move is next
+/// to the pawn which can be captured.
+/// </summary>
+/// <param name="c">position</param>
+/// <returns>64 bit Polyglot key of c</returns>
+u64 polyglot_key(const chess_state *c);
+
+/// <summary>
+/// Encode a move for a book entry
+/// </summary>
+u16 book_encode_move(move m);
+
+/// <summary>
+/// Sort entries, merge the ones with equal position and move by adding their weights and write them as a book
+/// </summary>
+/// <param name="path">book file to create</param>
+/// <param name="entries">entries in any order, sorted and merged afterwards</param>
+/// <param name="entry_num">number of entries, receives the number of merged entries written</param>
+/// <returns>false if the file could not be written</returns>
+bool book_write(const char *path, book_entry *entries, u64 *entry_num);
+
+/// <summary>
+/// Build a book from the first plies of the games of a PGN file. A move is weighted 2 for every game won
+/// by the side playing it and 1 for every drawn or unfinished game, lost games count 0.
+/// </summary>
+/// <param name="pgn_path">game collection</param>
+/// <param name="book_path">book file to create</param>
+/// <param name="max_ply">moves taken from the start of every game</param>
+/// <param name="thread_num">threads replaying the games</param>
+/// <param name="entry_num">receives the number of entries written</param>
+/// <returns>false if the games could not be read or the book could not be written</returns>
+bool book_build(const char *pgn_path, const char *book_path, u32 max_ply, u32 thread_num, u64 *entry_num);
+
+#endif
@@ -1,404 +1,882 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "attacks.h"
 #include "chess.h"
 #include "log.h"
-
-static dllist *unchecked_moves_starting_from(const chess_state *c, pos p, dllist *move);
-static bool filter_check_own_check_after_move(move *m);
-static move_target check_target_valid(const chess_state *c, pos to, move_target target_types);
-static bool add_move_if_target_valid(const chess_state *c, pos from, pos to, dllist *moves, move_target target_types);
-static move *clone_move(const move *m);
-static dllist *create_movelist(void);
-static void populate_moves_after_move(move *m);
-static dllist *unchecked_to_actual_moves(dllist *moves);
-static bool check_winning_move(const move *m);
+#include "profile.h"
+#include "zobrist.h"
+
+static void start_game(chess *c);
+static void update_game_status(chess *c);
+static void game_record_push(game_record *r, const chess_state *c, move m);
+static void add_moves_to_targets(const chess_state *c, move_list *moves, u32 from, bitboard targets);
+static void add_move(move_list *moves, move m);
+static bool square_attacked(const chess_state *c, u32 square, piece_color attacker);
+static bitboard attackers_to(const chess_state *c, u32 square, bitboard occupied);
+static bitboard squares_between(u32 a, u32 b);
+static void put_piece(chess_state *c, u32 square, piece_color color, piece_type t);
+static void remove_piece(chess_state *c, u32 square, piece_color color, piece_type t);
+static u64 rights_key(const chess_state *c);
+
+/* squares between king and rook, which have to be empty for castling */
+static const bitboard castle_path[DIRECTION_MAX][COLOR_MAX] = {
+	{ SQUARE_BB(SQUARE(1, 0)) | SQUARE_BB(SQUARE(2, 0)) | SQUARE_BB(SQUARE(3, 0)), SQUARE_BB(SQUARE(1, 7)) | SQUARE_BB(SQUARE(2, 7)) | SQUARE_BB(SQUARE(3, 7)) },
+	{ SQUARE_BB(SQUARE(5, 0)) | SQUARE_BB(SQUARE(6, 0)), SQUARE_BB(SQUARE(5, 7)) | SQUARE_BB(SQUARE(6, 7)) },
+};
+
+/* king and rook starting squares, moving from or to one of them loses the castling right */
+static const bitboard castle_rights_mask[DIRECTION_MAX][COLOR_MAX] = {
+	{ SQUARE_BB(SQUARE(0, 0)) | SQUARE_BB(SQUARE(4, 0)), SQUARE_BB(SQUARE(0, 7)) | SQUARE_BB(SQUARE(4, 7)) },
+	{ SQUARE_BB(SQUARE(7, 0)) | SQUARE_BB(SQUARE(4, 0)), SQUARE_BB(SQUARE(7, 7)) | SQUARE_BB(SQUARE(4, 7)) },
+};
+
+/* FEN letters of the piece types, lower case for black */
+static const char piece_chars[PIECE_TYPE_MAX] = { 'p', 'r', 'n', 'b', 'q', 'k' };
 
 void print_move(const move *m)
 {
-	LOG_INFO("Move from (%hhu,%hhu) to (%hhu,%hhu)", m->from.x, m->from.y, m->to.x, m->to.y);
+	LOG_INFO("Move from (%hhu,%hhu) to (%hhu,%hhu)", SQUARE_X(move_from(*m)), SQUARE_Y(move_from(*m)), SQUARE_X(move_to(*m)), SQUARE_Y(move_to(*m)));
 }
 
-chess *init_chess(chess *c) {
-	pos p;
-	chess initial_state = {
-		.current_state = (chess_state)
-		{
-			.active_color = WHITE,
-			.can_castle = {{true, true}, {true, true}},
-			.allowed_moves = {0},
-			.can_en_pessant = {0},
-			.board = {
-				{(piece) { true, WHITE, ROOK }, (piece) { true, WHITE, KNIGHT }, (piece) { true, WHITE, BISHOP }, (piece) { true, WHITE, QUEEN }, (piece) { true, WHITE, KING }, (piece) { true, WHITE, BISHOP }, (piece) { true, WHITE, KNIGHT }, (piece) { true, WHITE, ROOK }},
-				{(piece) { true, WHITE, PAWN }, (piece) { true, WHITE, PAWN }, (piece) { true, WHITE, PAWN }, (piece) { true, WHITE, PAWN }, (piece) { true, WHITE, PAWN }, (piece) { true, WHITE, PAWN }, (piece) { true, WHITE, PAWN }, (piece) { true, WHITE, PAWN }},
-				{0, 0, 0, 0, 0, 0, 0, 0},
-				{0, 0, 0, 0, 0, 0, 0, 0},
-				{0, 0, 0, 0, 0, 0, 0, 0},
-				{0, 0, 0, 0, 0, 0, 0, 0},
-				{(piece) { true, BLACK, PAWN }, (piece) { true, BLACK, PAWN }, (piece) { true, BLACK, PAWN }, (piece) { true, BLACK, PAWN }, (piece) { true, BLACK, PAWN }, (piece) { true, BLACK, PAWN }, (piece) { true, BLACK, PAWN }, (piece) { true, BLACK, PAWN }},
-				{(piece) { true, BLACK, ROOK }, (piece) { true, BLACK, KNIGHT }, (piece) { true, BLACK, BISHOP }, (piece) { true, BLACK, QUEEN }, (piece) { true, BLACK, KING }, (piece) { true, BLACK, BISHOP }, (piece) { true, BLACK, KNIGHT }, (piece) { true, BLACK, ROOK }},
-			}
-		},
-		.is_game_over = false
-	};
+char *move_to_string(move m, char *out)
+{
+	out[0] = 'a' + SQUARE_X(move_from(m));
+	out[1] = '1' + SQUARE_Y(move_from(m));
+	out[2] = 'a' + SQUARE_X(move_to(m));
+	out[3] = '1' + SQUARE_Y(move_to(m));
+	out[4] = move_is_promotion(m) ? piece_chars[move_promotion(m)] : '\0';
+	out[5] = '\0';
+	return out;
+}
 
-	dllist_init(&initial_state.history, clone_move, free);
+bool chess_state_from_fen(chess_state *c, const char *fen)
+{
+	chess_state s = { .active_color = WHITE, .en_pessant_file = -1, .fullmove_number = 1 };
+	piece_color color;
+	piece_type t;
+	i32 x = 0, y = BOARD_SIDE_LENGTH - 1;
+
+	ASSERT_ERROR (c && fen, "Argument c or fen is NULL");
+	attacks_init();
+
+	// piece placement, starting at a8
+	for (; *fen && *fen != ' '; ++fen) {
+		if (*fen == '/') {
+			if (x != BOARD_SIDE_LENGTH || y == 0)
+				return false;
+			--y;
+			x = 0;
+		} else if ('1' <= *fen && *fen <= '8') {
+			x += *fen - '0';
+		} else {
+			color = ('a' <= *fen && *fen <= 'z') ? BLACK : WHITE;
+			for (t = 0; t < PIECE_TYPE_MAX && piece_chars[t] != (*fen | 0x20); ++t);
+			if (t == PIECE_TYPE_MAX || x >= BOARD_SIDE_LENGTH)
+				return false;
+			put_piece(&s, SQUARE(x, y), color, t);
+			++x;
+		}
+		if (x > BOARD_SIDE_LENGTH)
+			return false;
+	}
+	if (x != BOARD_SIDE_LENGTH || y != 0
+		|| bb_popcount(s.pieces[WHITE][KING]) != 1 || bb_popcount(s.pieces[BLACK][KING]) != 1)
+	{
+		return false;
+	}
 
-	ASSERT_ERROR (c, "Argument c was NULL");
-	ASSERT_ERROR (memcpy(c, &initial_state, sizeof (chess)), "memcpy returned NULL");
-	for (p.y = 0; p.y < BOARD_SIDE_LENGTH; ++p.y) {
-		for (p.x = 0; p.x < BOARD_SIDE_LENGTH; ++p.x) {
-			dllist_init(&c->current_state.allowed_moves[p.y][p.x], clone_move, free);
+	// active color
+	for (; *fen == ' '; ++fen);
+	if (*fen != 'w' && *fen != 'b')
+		return false;
+	s.active_color = (*fen++ == 'w') ? WHITE : BLACK;
+
+	// castling rights
+	for (; *fen == ' '; ++fen);
+	for (; *fen && *fen != ' '; ++fen) {
+		switch (*fen) {
+		case 'K': s.can_castle[RIGHT][WHITE] = true; break;
+		case 'Q': s.can_castle[LEFT][WHITE] = true; break;
+		case 'k': s.can_castle[RIGHT][BLACK] = true; break;
+		case 'q': s.can_castle[LEFT][BLACK] = true; break;
+		case '-': break;
+		default: return false;
 		}
 	}
+	// only keep castling rights with king and rook on their starting squares
+	for (color = 0; color < COLOR_MAX; ++color) {
+		s.can_castle[LEFT][color] &= ((s.pieces[color][KING] | s.pieces[color][ROOK]) & castle_rights_mask[LEFT][color]) == castle_rights_mask[LEFT][color];
+		s.can_castle[RIGHT][color] &= ((s.pieces[color][KING] | s.pieces[color][ROOK]) & castle_rights_mask[RIGHT][color]) == castle_rights_mask[RIGHT][color];
+	}
 
-	for (p.y = 0; p.y < BOARD_SIDE_LENGTH; ++p.y) {
-		for (p.x = 0; p.x < BOARD_SIDE_LENGTH; ++p.x) {
-			unchecked_moves_starting_from(&c->current_state, p, &c->current_state.allowed_moves[p.y][p.x]);
-			unchecked_to_actual_moves(&c->current_state.allowed_moves[p.y][p.x]);
+	// en pessant target square
+	for (; *fen == ' '; ++fen);
+	if ('a' <= fen[0] && fen[0] <= 'h' && fen[1] == (s.active_color == WHITE ? '6' : '3')) {
+		// ignore the square if there is no pawn which just moved past it or none to capture it, like make_move
+		x = fen[0] - 'a';
+		y = (s.active_color == WHITE) ? 4 : 3;
+		if ((s.pieces[s.active_color == WHITE ? BLACK : WHITE][PAWN] & SQUARE_BB(SQUARE(x, y)))
+			&& (s.pieces[s.active_color][PAWN] & (bb_shift(SQUARE_BB(SQUARE(x, y)), 1, 0) | bb_shift(SQUARE_BB(SQUARE(x, y)), -1, 0))))
+		{
+			s.en_pessant_file = (i8) x;
 		}
+	} else if (fen[0] && fen[0] != '-') {
+		return false;
 	}
 
-	return c;
+	// optional move counters
+	for (; *fen && *fen != ' '; ++fen);
+	for (; *fen == ' '; ++fen);
+	if ('0' <= *fen && *fen <= '9') {
+		s.halfmove_clock = (u16) strtoul(fen, (char **) &fen, 10);
+		for (; *fen == ' '; ++fen);
+		if ('1' <= *fen && *fen <= '9')
+			s.fullmove_number = (u16) strtoul(fen, NULL, 10);
+	}
+
+	s.key = zobrist_key(&s);
+	*c = s;
+	return true;
 }
 
-bool try_move(chess *c, pos from, pos to)
+char *chess_state_to_fen(const chess_state *c, char *out)
 {
-	// find if move exists
-	dllist_elem *iter = c->current_state.allowed_moves[from.y][from.x].head;
-	move *m, *m_copy;
-	pos p;
-	u64 move_num = 0;
-	while (iter)
-	{
-		m = (move *) iter->data;
-		if (m->to.x == to.x && m->to.y == to.y) {
-			// Add move to history
-			m_copy = malloc(sizeof (move));
-			ASSERT_ERROR (m_copy, "calloc returned NULL!");
-			ASSERT_ERROR (memcpy(m_copy, m, sizeof (move)), "memcpy returned NULL!");
-			dllist_insert_head(&c->history, m_copy);
-
-			// set after state as current state
-			ASSERT_ERROR (memcpy(&c->current_state, &m->after, sizeof (chess_state)), "memcpy returned NULL!");
-			for (p.y = 0; p.y < BOARD_SIDE_LENGTH; ++p.y) {
-				for (p.x = 0; p.x < BOARD_SIDE_LENGTH; ++p.x) {
-					if (dllist_size(&c->current_state.allowed_moves[p.y][p.x]) > 0) {
-						unchecked_to_actual_moves(&c->current_state.allowed_moves[p.y][p.x]);
-						move_num += dllist_size(&c->current_state.allowed_moves[p.y][p.x]);
-					}
-				}
+	static const char castle_chars[DIRECTION_MAX][COLOR_MAX] = { { 'Q', 'q' }, { 'K', 'k' } };
+	char *p = out;
+	piece_color color;
+	piece_type t;
+	i32 x, y, empty;
+
+	// piece placement, starting at a8
+	for (y = BOARD_SIDE_LENGTH - 1; y >= 0; --y) {
+		for (x = 0, empty = 0; x < BOARD_SIDE_LENGTH; ++x) {
+			color = (c->occupied[WHITE] & SQUARE_BB(SQUARE(x, y))) ? WHITE : BLACK;
+			t = piece_type_at(c, SQUARE(x, y), color);
+			if (t == PIECE_TYPE_MAX) {
+				++empty;
+				continue;
 			}
-			c->is_game_over = (move_num == 0);
-
-			if (c->is_game_over) {
-				// check if the other player has a check on the board
-				// if so, the the player is the winner, else it is a draw
-				c->current_state.active_color = c->current_state.active_color == WHITE ? BLACK : WHITE;
-				c->winner = c->current_state.active_color;
-				c->is_draw = true;
-				for (p.y = 0; p.y < BOARD_SIDE_LENGTH && c->is_draw; ++p.y) {
-					for (p.x = 0; p.x < BOARD_SIDE_LENGTH && c->is_draw; ++p.x) {
-						unchecked_moves_starting_from(&c->current_state, p, &c->current_state.allowed_moves[p.y][p.x]);
-						if (dllist_exists(&c->current_state.allowed_moves[p.y][p.x], check_winning_move)) {
-							c->is_draw = false;
-						}
-					}
-				}
-			}
-			return true;
+			if (empty)
+				*p++ = (char) ('0' + empty);
+			empty = 0;
+			*p++ = (color == WHITE) ? (char) (piece_chars[t] & ~0x20) : piece_chars[t];
 		}
-		iter = iter->next;
+		if (empty)
+			*p++ = (char) ('0' + empty);
+		if (y)
+			*p++ = '/';
 	}
-	return false;
-}
 
-const dllist *valid_moves_from(const chess *c, pos p)
-{
-	return &c->current_state.allowed_moves[p.y][p.x];
+	*p++ = ' ';
+	*p++ = (c->active_color == WHITE) ? 'w' : 'b';
+
+	*p++ = ' ';
+	for (color = 0; color < COLOR_MAX; ++color) {
+		if (c->can_castle[RIGHT][color])
+			*p++ = castle_chars[RIGHT][color];
+		if (c->can_castle[LEFT][color])
+			*p++ = castle_chars[LEFT][color];
+	}
+	if (p[-1] == ' ')
+		*p++ = '-';
+
+	*p++ = ' ';
+	if (c->en_pessant_file >= 0) {
+		*p++ = (char) ('a' + c->en_pessant_file);
+		*p++ = (c->active_color == WHITE) ? '6' : '3';
+	} else {
+		*p++ = '-';
+	}
+
+	snprintf(p, (size_t) (FEN_MAX - (p - out)), " %u %u", c->halfmove_clock, c->fullmove_number);
+	return out;
 }
 
-static dllist *unchecked_to_actual_moves(dllist *moves)
+bool parse_move(const chess_state *c, const char *s, move *m, const char **end)
 {
-	dllist_apply(moves, &populate_moves_after_move);
-	LOG_DEBUG ("list size before filter_check_own_check_after_move %hhu", dllist_size(moves));
-	dllist_filter(moves, &filter_check_own_check_after_move);
-	LOG_DEBUG ("list size after filter_check_own_check_after_move %hhu", dllist_size(moves));
-	dllist_apply(moves, print_move);
-	return moves;
+	move_list moves;
 
+	return parse_move_in_list(c, generate_moves(c, &moves), s, m, end);
 }
 
-static void populate_moves_after_move(move *m)
+bool parse_move_in_list(const chess_state *c, const move_list *moves, const char *s, move *m, const char **end)
 {
-	pos p;
-	for (p.y = 0; p.y < BOARD_SIDE_LENGTH; ++p.y) {
-		for (p.x = 0; p.x < BOARD_SIDE_LENGTH; ++p.x) {
-			dllist_init(&m->after.allowed_moves[p.y][p.x], clone_move, free);
-			unchecked_moves_starting_from(&m->after, p, &m->after.allowed_moves[p.y][p.x]);
+	static const char san_pieces[] = "PRNBQK"; /* SAN letters in piece_type order */
+	move_flag castle = MOVE_QUIET;
+	piece_type t = PAWN, promotion = PIECE_TYPE_MAX;
+	i32 from_x = -1, from_y = -1, to_x = -1, to_y = -1;
+	char coordinates[6], squares[4];
+	const char *letter;
+	u32 i, square_num = 0, found = 0;
+
+	// coordinate notation, a castling king move is written as its king move, e.g. "e1g1"
+	if ('a' <= s[0] && s[0] <= 'h' && '1' <= s[1] && s[1] <= '8' && 'a' <= s[2] && s[2] <= 'h' && '1' <= s[3] && s[3] <= '8') {
+		for (i = 0; i < moves->size; ++i) {
+			move_to_string(moves->moves[i], coordinates);
+			if (!strncmp(s, coordinates, strlen(coordinates)) && (coordinates[4] || !s[4] || !strchr("nbrq", s[4]))) {
+				*m = moves->moves[i];
+				if (end)
+					*end = s + strlen(coordinates);
+				return true;
+			}
 		}
+		return false;
 	}
-}
 
-static bool filter_check_own_check_after_move(move *m)
-{
-	pos attacker_pos;
-	ASSERT_ERROR (m, "Argument is NULL");
-	for (attacker_pos.y = 0; attacker_pos.y < BOARD_SIDE_LENGTH; ++attacker_pos.y) {
-		for (attacker_pos.x = 0; attacker_pos.x < BOARD_SIDE_LENGTH; ++attacker_pos.x) {
-			dllist_apply(&m->after.allowed_moves[attacker_pos.y][attacker_pos.x], print_move);
-			if (dllist_exists(&m->after.allowed_moves[attacker_pos.y][attacker_pos.x], &check_winning_move)) {
-				return false;
+	if (!strncmp(s, "O-O-O", 5) || !strncmp(s, "0-0-0", 5)) {
+		castle = MOVE_CASTLE_L;
+		s += 5;
+	} else if (!strncmp(s, "O-O", 3) || !strncmp(s, "0-0", 3)) {
+		castle = MOVE_CASTLE_R;
+		s += 3;
+	} else {
+		if (*s && (letter = strchr(san_pieces, *s)) != NULL) {
+			t = (piece_type) (letter - san_pieces);
+			++s;
+		}
+		// up to a starting square for disambiguation, then the target square, captures marked by 'x'
+		for (; square_num < 4 && (('a' <= *s && *s <= 'h') || ('1' <= *s && *s <= '8') || *s == 'x'); ++s) {
+			if (*s != 'x')
+				squares[square_num++] = *s;
+		}
+		if (square_num < 2 || squares[square_num - 2] < 'a' || squares[square_num - 1] > '8')
+			return false;
+		to_x = squares[square_num - 2] - 'a';
+		to_y = squares[square_num - 1] - '1';
+		for (i = 0; i + 2 < square_num; ++i) {
+			if (squares[i] >= 'a')
+				from_x = squares[i] - 'a';
+			else
+				from_y = squares[i] - '1';
+		}
+		if (t == PAWN && *s) {
+			letter = strchr(san_pieces + 1, s[*s == '=']);
+			if (letter && letter < san_pieces + KING) {
+				promotion = (piece_type) (letter - san_pieces);
+				s += 1 + (*s == '=');
 			}
 		}
 	}
+	for (; *s && strchr("+#!?", *s); ++s);
+
+	for (i = 0; i < moves->size; ++i) {
+		if (castle != MOVE_QUIET) {
+			if (move_flags(moves->moves[i]) != castle)
+				continue;
+		} else if (move_flags(moves->moves[i]) == MOVE_CASTLE_L || move_flags(moves->moves[i]) == MOVE_CASTLE_R
+			|| move_to(moves->moves[i]) != (u32) SQUARE(to_x, to_y)
+			|| piece_type_at(c, move_from(moves->moves[i]), c->active_color) != t
+			|| (from_x >= 0 && SQUARE_X(move_from(moves->moves[i])) != (u32) from_x)
+			|| (from_y >= 0 && SQUARE_Y(move_from(moves->moves[i])) != (u32) from_y)
+			|| (move_is_promotion(moves->moves[i]) ? move_promotion(moves->moves[i]) != promotion : promotion != PIECE_TYPE_MAX))
+		{
+			continue;
+		}
+		*m = moves->moves[i];
+		++found;
+	}
+	if (found != 1)
+		return false;
+	if (end)
+		*end = s;
 	return true;
 }
 
-static dllist *unchecked_moves_starting_from(const chess_state *c, pos p, dllist *moves)
-{
-	i32 x_target, y_target;
-
-	ASSERT_ERROR (c && (p.x < BOARD_SIDE_LENGTH) && (p.y < BOARD_SIDE_LENGTH), "Error invalid arguments");
-
-	if (!c->board[p.y][p.x].is_piece || c->active_color != (c->board[p.y][p.x].c) || !c->board[p.y][p.x].is_piece) {
-		return moves;
-	}
+chess *init_chess(chess *c) {
+	chess initial_state = {
+		.current_state = (chess_state)
+		{
+			.active_color = WHITE,
+			.can_castle = {{true, true}, {true, true}},
+			.en_pessant_file = -1,
+			.pieces = {
+				{ BB_RANK_2, SQUARE_BB(SQUARE(0, 0)) | SQUARE_BB(SQUARE(7, 0)), SQUARE_BB(SQUARE(1, 0)) | SQUARE_BB(SQUARE(6, 0)), SQUARE_BB(SQUARE(2, 0)) | SQUARE_BB(SQUARE(5, 0)), SQUARE_BB(SQUARE(3, 0)), SQUARE_BB(SQUARE(4, 0)) },
+				{ BB_RANK_7, SQUARE_BB(SQUARE(0, 7)) | SQUARE_BB(SQUARE(7, 7)), SQUARE_BB(SQUARE(1, 7)) | SQUARE_BB(SQUARE(6, 7)), SQUARE_BB(SQUARE(2, 7)) | SQUARE_BB(SQUARE(5, 7)), SQUARE_BB(SQUARE(3, 7)), SQUARE_BB(SQUARE(4, 7)) },
+			},
+			.occupied = { BB_RANK_1 | BB_RANK_2, BB_RANK_7 | BB_RANK_8 },
+			.occupied_all = BB_RANK_1 | BB_RANK_2 | BB_RANK_7 | BB_RANK_8,
+			.fullmove_number = 1,
+		},
+		.is_game_over = false
+	};
 
-	switch (c->board[p.y][p.x].t) {
-	case PAWN: // TODO test
-		ASSERT_ERROR (p.y > 0 && p.y < BOARD_SIDE_LENGTH - 1, "%s pawn on invalid rank %hhu", piece_color_string(c->active_color), p.y + 1);
+	attacks_init();
+	initial_state.current_state.key = zobrist_key(&initial_state.current_state);
 
-		// check move one straight
-		if (add_move_if_target_valid(c, p, (pos) { p.x, p.y + (c->active_color == WHITE ? 1 : (-1)) }, moves, TARGET_EMPTY)) {
-			// check double moves from beginning rank
-			if (p.y == 1 && c->active_color == WHITE || p.y == 6)
-				add_move_if_target_valid(c, p, (pos) { p.x, (c->active_color == WHITE ? 3 : 4) }, moves, TARGET_EMPTY);
-		}
+	ASSERT_ERROR (c, "Argument c was NULL");
+	ASSERT_ERROR (memcpy(c, &initial_state, sizeof (chess)), "memcpy returned NULL");
 
-		// check attacks left and right
-		add_move_if_target_valid(c, p, (pos) { p.x + 1, p.y + (c->active_color == WHITE ? 1 : -1) }, moves, TARGET_ENEMY);
-		add_move_if_target_valid(c, p, (pos) { p.x - 1, p.y + (c->active_color == WHITE ? 1 : -1) }, moves, TARGET_ENEMY);
+	start_game(c);
+	return c;
+}
 
-		break;
+bool init_chess_from_fen(chess *c, const char *fen)
+{
+	chess_state s;
 
-	case ROOK:
-		for (y_target = p.y + 1; add_move_if_target_valid(c, p, (pos) { p.x, y_target }, moves, TARGET_EMPTY); y_target++);
-		add_move_if_target_valid(c, p, (pos) { p.x, y_target }, moves, TARGET_ENEMY);
+	if (!chess_state_from_fen(&s, fen))
+		return false;
+	memset(c, 0, sizeof (chess));
+	c->current_state = s;
+	start_game(c);
+	return true;
+}
 
-		for (y_target = p.y - 1; add_move_if_target_valid(c, p, (pos) { p.x, y_target }, moves, TARGET_EMPTY); y_target--);
-		add_move_if_target_valid(c, p, (pos) { p.x, y_target }, moves, TARGET_ENEMY);
+void free_chess(chess *c)
+{
+	vector_free(&c->record.moves);
+	vector_free(&c->record.checkpoints);
+	c->record.ply = 0;
+}
 
-		for (x_target = p.x + 1; add_move_if_target_valid(c, p, (pos) { x_target, p.y }, moves, TARGET_EMPTY); x_target++);
-		add_move_if_target_valid(c, p, (pos) { x_target, p.y }, moves, TARGET_ENEMY);
+// empty record starting at the current state
+static void start_game(chess *c)
+{
+	vector_init(&c->record.moves, sizeof (move))->subsystem = MEM_GAME;
+	vector_init(&c->record.checkpoints, sizeof (chess_state))->subsystem = MEM_GAME;
+	restart_chess(c, &c->current_state);
+}
 
-		for (x_target = p.x - 1; add_move_if_target_valid(c, p, (pos) { x_target, p.y }, moves, TARGET_EMPTY); x_target--);
-		add_move_if_target_valid(c, p, (pos) { x_target, p.y }, moves, TARGET_ENEMY);
+void restart_chess(chess *c, const chess_state *s)
+{
+	c->current_state = *s;
+	vector_resize(&c->record.moves, 0);
+	vector_resize(&c->record.checkpoints, 0);
+	vector_push(&c->record.checkpoints, &c->current_state);
+	c->record.ply = 0;
+
+	position_history_init(&c->positions, &c->current_state);
+	update_game_status(c);
+}
 
-		break;
+bool try_move(chess *c, pos from, pos to)
+{
+	u32 i, from_square = (u32) SQUARE(from.x, from.y), to_square = (u32) SQUARE(to.x, to.y);
+	move m;
 
-	case KNIGHT:
-		add_move_if_target_valid(c, p, (pos) { p.x + 1, p.y + 2 }, moves, TARGET_ENEMY | TARGET_EMPTY);
-		add_move_if_target_valid(c, p, (pos) { p.x - 1, p.y + 2 }, moves, TARGET_ENEMY | TARGET_EMPTY);
-		add_move_if_target_valid(c, p, (pos) { p.x + 1, p.y - 2 }, moves, TARGET_ENEMY | TARGET_EMPTY);
-		add_move_if_target_valid(c, p, (pos) { p.x - 1, p.y - 2 }, moves, TARGET_ENEMY | TARGET_EMPTY);
-		add_move_if_target_valid(c, p, (pos) { p.x + 2, p.y + 1 }, moves, TARGET_ENEMY | TARGET_EMPTY);
-		add_move_if_target_valid(c, p, (pos) { p.x - 2, p.y + 1 }, moves, TARGET_ENEMY | TARGET_EMPTY);
-		add_move_if_target_valid(c, p, (pos) { p.x + 2, p.y - 1 }, moves, TARGET_ENEMY | TARGET_EMPTY);
-		add_move_if_target_valid(c, p, (pos) { p.x - 2, p.y - 1 }, moves, TARGET_ENEMY | TARGET_EMPTY);
-		
+	// find if move exists
+	for (i = 0; i < c->allowed_moves.size; ++i) {
+		m = c->allowed_moves.moves[i];
+		// pawns reaching the last rank are promoted to a queen
+		if (move_from(m) == from_square && move_to(m) == to_square
+			&& (!move_is_promotion(m) || move_promotion(m) == QUEEN))
+		{
+			return play_move(c, m);
+		}
+	}
+	return false;
+}
 
-		break;
+bool play_move(chess *c, move m)
+{
+	u32 i;
+	move_undo u;
+	PROFILE_BEGIN(PROFILE_PLAY_MOVE);
+
+	for (i = 0; i < c->allowed_moves.size && c->allowed_moves.moves[i] != m; ++i);
+	if (i == c->allowed_moves.size) {
+		PROFILE_END(PROFILE_PLAY_MOVE);
+		return false;
+	}
 
-	case BISHOP:
-		for (x_target = p.x + 1, y_target = p.y + 1; add_move_if_target_valid(c, p, (pos) { x_target, y_target }, moves, TARGET_EMPTY); x_target++, y_target++);
-		add_move_if_target_valid(c, p, (pos) { x_target, y_target }, moves, TARGET_ENEMY);
+	{
+		PROFILE_BEGIN(PROFILE_RECORD);
+		game_record_push(&c->record, &c->current_state, m);
+		PROFILE_END(PROFILE_RECORD);
+	}
+	{
+		PROFILE_BEGIN(PROFILE_MAKE_MOVE);
+		make_move(&c->current_state, m, &u);
+		position_history_push(&c->positions, &c->current_state);
+		PROFILE_END(PROFILE_MAKE_MOVE);
+	}
+	{
+		PROFILE_BEGIN(PROFILE_GAME_STATUS);
+		update_game_status(c);
+		PROFILE_END(PROFILE_GAME_STATUS);
+	}
+	PROFILE_END(PROFILE_PLAY_MOVE);
+	return true;
+}
 
-		for (x_target = p.x + 1, y_target = p.y - 1; add_move_if_target_valid(c, p, (pos) { x_target, y_target }, moves, TARGET_EMPTY); x_target++, y_target--);
-		add_move_if_target_valid(c, p, (pos) { x_target, y_target }, moves, TARGET_ENEMY);
+bool undo_move(chess *c)
+{
+	return c->record.ply > 0 && seek_ply(c, c->record.ply - 1);
+}
 
-		for (x_target = p.x - 1, y_target = p.y + 1; add_move_if_target_valid(c, p, (pos) { x_target, y_target }, moves, TARGET_EMPTY); x_target--, y_target++);
-		add_move_if_target_valid(c, p, (pos) { x_target, y_target }, moves, TARGET_ENEMY);
+bool redo_move(chess *c)
+{
+	const game_record *r = &c->record;
+	return r->ply < vector_size(&r->moves) && play_move(c, *(move *) vector_at(&r->moves, r->ply));
+}
 
-		for (x_target = p.x - 1, y_target = p.y - 1; add_move_if_target_valid(c, p, (pos) { x_target, y_target }, moves, TARGET_EMPTY); x_target--, y_target--);
-		add_move_if_target_valid(c, p, (pos) { x_target, y_target }, moves, TARGET_ENEMY);
+bool seek_ply(chess *c, u32 ply)
+{
+	game_record *r = &c->record;
+	const move *moves = r->moves.data;
+	move_undo u;
+	u32 i, from;
+	PROFILE_BEGIN(PROFILE_SEEK);
+
+	if (ply > vector_size(&r->moves)) {
+		PROFILE_END(PROFILE_SEEK);
+		return false;
+	}
 
-		break;
+	// a position older than FIFTY_MOVE_PLIES plies can only be repeated after the game is over,
+	// so the repetition history is rebuilt from there and the rest comes from a checkpoint
+	from = ply > FIFTY_MOVE_PLIES ? ply - FIFTY_MOVE_PLIES : 0;
+	i = from - from % GAME_CHECKPOINT_INTERVAL;
+	c->current_state = *(chess_state *) vector_at(&r->checkpoints, i / GAME_CHECKPOINT_INTERVAL);
+	PROFILE_COUNT(PROFILE_BYTES_COPIED, sizeof (chess_state));
+	for (; i < from; ++i)
+		make_move(&c->current_state, moves[i], &u);
+	position_history_init(&c->positions, &c->current_state);
+	for (; i < ply; ++i) {
+		make_move(&c->current_state, moves[i], &u);
+		position_history_push(&c->positions, &c->current_state);
+	}
 
-	case QUEEN:
-		for (x_target = p.x + 1, y_target = p.y + 1; add_move_if_target_valid(c, p, (pos) { x_target, y_target }, moves, TARGET_EMPTY); x_target++, y_target++);
-		add_move_if_target_valid(c, p, (pos) { x_target, y_target }, moves, TARGET_ENEMY);
+	r->ply = ply;
+	update_game_status(c);
+	PROFILE_END(PROFILE_SEEK);
+	return true;
+}
 
-		for (x_target = p.x + 1, y_target = p.y - 1; add_move_if_target_valid(c, p, (pos) { x_target, y_target }, moves, TARGET_EMPTY); x_target++, y_target--);
-		add_move_if_target_valid(c, p, (pos) { x_target, y_target }, moves, TARGET_ENEMY);
+// legal moves and game end of the current state
+static void update_game_status(chess *c)
+{
+	c->is_game_over = (generate_moves(&c->current_state, &c->allowed_moves)->size == 0);
+	c->is_draw = false;
+
+	if (c->is_game_over) {
+		// check if the other player has a check on the board
+		// if so, the the player is the winner, else it is a draw
+		c->winner = c->current_state.active_color == WHITE ? BLACK : WHITE;
+		c->is_draw = !in_check(&c->current_state, c->current_state.active_color);
+	} else if (c->current_state.halfmove_clock >= FIFTY_MOVE_PLIES || position_history_repetitions(&c->positions) >= 2) {
+		c->is_game_over = true;
+		c->is_draw = true;
+	}
+}
 
-		for (x_target = p.x - 1, y_target = p.y + 1; add_move_if_target_valid(c, p, (pos) { x_target, y_target }, moves, TARGET_EMPTY); x_target--, y_target++);
-		add_move_if_target_valid(c, p, (pos) { x_target, y_target }, moves, TARGET_ENEMY);
+// record m played in state c, replacing the undone moves unless m is the next one of them
+static void game_record_push(game_record *r, const chess_state *c, move m)
+{
+	if (r->ply < vector_size(&r->moves) && *(move *) vector_at(&r->moves, r->ply) == m) {
+		++r->ply;
+		return;
+	}
+	vector_resize(&r->moves, r->ply);
+	vector_resize(&r->checkpoints, (r->ply + GAME_CHECKPOINT_INTERVAL - 1) / GAME_CHECKPOINT_INTERVAL);
 
-		for (x_target = p.x - 1, y_target = p.y - 1; add_move_if_target_valid(c, p, (pos) { x_target, y_target }, moves, TARGET_EMPTY); x_target--, y_target--);
-		add_move_if_target_valid(c, p, (pos) { x_target, y_target }, moves, TARGET_ENEMY);
+	if (r->ply % GAME_CHECKPOINT_INTERVAL == 0) {
+		vector_push(&r->checkpoints, c);
+		PROFILE_COUNT(PROFILE_BYTES_COPIED, sizeof (chess_state));
+	}
+	vector_push(&r->moves, &m);
+	++r->ply;
+}
 
-		for (y_target = p.y + 1; add_move_if_target_valid(c, p, (pos) { p.x, y_target }, moves, TARGET_EMPTY); y_target++);
-		add_move_if_target_valid(c, p, (pos) { p.x, y_target }, moves, TARGET_ENEMY);
+void position_history_init(position_history *h, const chess_state *c)
+{
+	h->keys[0] = c->key;
+	h->size = 1;
+}
 
-		for (y_target = p.y - 1; add_move_if_target_valid(c, p, (pos) { p.x, y_target }, moves, TARGET_EMPTY); y_target--);
-		add_move_if_target_valid(c, p, (pos) { p.x, y_target }, moves, TARGET_ENEMY);
+void position_history_push(position_history *h, const chess_state *c)
+{
+	// earlier positions had other pieces or castling rights than every later one
+	if (c->halfmove_clock == 0 || h->size == POSITION_HISTORY_CAPACITY)
+		h->size = 0;
+	h->keys[h->size++] = c->key;
+}
 
-		for (x_target = p.x + 1; add_move_if_target_valid(c, p, (pos) { x_target, p.y }, moves, TARGET_EMPTY); x_target++);
-		add_move_if_target_valid(c, p, (pos) { x_target, p.y }, moves, TARGET_ENEMY);
+u32 position_history_repetitions(const position_history *h)
+{
+	u64 key = h->keys[h->size - 1];
+	u32 i, count = 0;
 
-		for (x_target = p.x - 1; add_move_if_target_valid(c, p, (pos) { x_target, p.y }, moves, TARGET_EMPTY); x_target--);
-		add_move_if_target_valid(c, p, (pos) { x_target, p.y }, moves, TARGET_ENEMY);
+	// only positions with the same side to move can be equal
+	for (i = 3; i <= h->size; i += 2) {
+		if (h->keys[h->size - i] == key)
+			++count;
+	}
+	return count;
+}
 
-		break;
+move_list *valid_moves_from(const chess *c, pos p, move_list *moves)
+{
+	u32 i, square = (u32) SQUARE(p.x, p.y);
 
-	case KING:
-		add_move_if_target_valid(c, p, (pos) { p.x + 1, p.y }, moves, TARGET_ENEMY | TARGET_EMPTY);
-		add_move_if_target_valid(c, p, (pos) { p.x - 1, p.y }, moves, TARGET_ENEMY | TARGET_EMPTY);
-		add_move_if_target_valid(c, p, (pos) { p.x, p.y + 1 }, moves, TARGET_ENEMY | TARGET_EMPTY);
-		add_move_if_target_valid(c, p, (pos) { p.x, p.y - 1 }, moves, TARGET_ENEMY | TARGET_EMPTY);
-		add_move_if_target_valid(c, p, (pos) { p.x + 1, p.y + 1 }, moves, TARGET_ENEMY | TARGET_EMPTY);
-		add_move_if_target_valid(c, p, (pos) { p.x - 1, p.y + 1 }, moves, TARGET_ENEMY | TARGET_EMPTY);
-		add_move_if_target_valid(c, p, (pos) { p.x + 1, p.y - 1 }, moves, TARGET_ENEMY | TARGET_EMPTY);
-		add_move_if_target_valid(c, p, (pos) { p.x - 1, p.y - 1 }, moves, TARGET_ENEMY | TARGET_EMPTY);
-
-		add_move_if_target_valid(c, p, (pos) { p.x - 2, p.y }, moves, CASTLE_L);
-		add_move_if_target_valid(c, p, (pos) { p.x + 2, p.y }, moves, CASTLE_R);
-		break;
+	moves->size = 0;
+	for (i = 0; i < c->allowed_moves.size; ++i) {
+		if (move_from(c->allowed_moves.moves[i]) == square)
+			moves->moves[moves->size++] = c->allowed_moves.moves[i];
 	}
-
 	return moves;
 }
 
-static move_target check_target_valid(const chess_state *c, pos to, move_target target_types)
+piece piece_at(const chess_state *c, pos p)
+{
+	bitboard b = SQUARE_BB(SQUARE(p.x, p.y));
+	piece_color color;
+	piece_type t;
+
+	for (color = 0; color < COLOR_MAX; ++color) {
+		if (!(c->occupied[color] & b))
+			continue;
+		for (t = 0; t < PIECE_TYPE_MAX; ++t) {
+			if (c->pieces[color][t] & b)
+				return (piece) { .is_piece = true, .c = color, .t = t };
+		}
+	}
+	return (piece) { .is_piece = false, .c = 0, .t = 0 };
+}
+
+move_list *generate_moves(const chess_state *c, move_list *moves)
 {
 	piece_color color = c->active_color;
+	piece_color enemy = (color == WHITE) ? BLACK : WHITE;
+	i32 forward = (color == WHITE) ? 1 : -1;
+	u32 home_rank = (color == WHITE) ? 0 : 7;
+	bitboard own = c->occupied[color];
+	bitboard king = c->pieces[color][KING];
+	bitboard pin_ray[SQUARE_NUM];
+	bitboard checkers, check_mask, pinned, snipers, blockers, pieces, targets, from_bb;
+	u32 king_square, square, from, to, captured;
+
+	PROFILE_COUNT(PROFILE_GENERATE_CALLS, 1);
+	moves->size = 0;
+	if (!king)
+		return moves;
+	king_square = bb_lsb(king);
+
+	// the king may step on every square which is not attacked once it has left its square
+	targets = king_attacks(king_square) & ~own;
+	while (targets) {
+		to = bb_pop_lsb(&targets);
+		if (!(attackers_to(c, to, c->occupied_all ^ king) & c->occupied[enemy]))
+			add_moves_to_targets(c, moves, king_square, SQUARE_BB(to));
+		else
+			PROFILE_COUNT(PROFILE_MOVES_FILTERED, 1);
+	}
 
-	if (!(0 <= to.x && to.x < BOARD_SIDE_LENGTH && 0 <= to.y && to.y < BOARD_SIDE_LENGTH))
-		return TARGET_INVALID;
+	// with two checkers only king moves are left
+	checkers = attackers_to(c, king_square, c->occupied_all) & c->occupied[enemy];
+	if (checkers & (checkers - 1))
+		return moves;
 
-	if (target_types & TARGET_ENEMY
-		&& c->board[to.y][to.x].is_piece
-		&& c->board[to.y][to.x].c != color)
-	{
-		return TARGET_ENEMY;
+	// a single checker has to be captured or blocked
+	check_mask = checkers ? (checkers | squares_between(king_square, bb_lsb(checkers))) : ~BB_EMPTY;
+
+	// a piece is pinned if it is the only one between the king and an enemy slider looking at it
+	pinned = BB_EMPTY;
+	snipers = (rook_attacks(king_square, c->occupied[enemy]) & (c->pieces[enemy][ROOK] | c->pieces[enemy][QUEEN]))
+		| (bishop_attacks(king_square, c->occupied[enemy]) & (c->pieces[enemy][BISHOP] | c->pieces[enemy][QUEEN]));
+	while (snipers) {
+		square = bb_pop_lsb(&snipers);
+		blockers = squares_between(king_square, square) & c->occupied_all;
+		if (blockers && !(blockers & (blockers - 1)) && (blockers & own)) {
+			pinned |= blockers;
+			pin_ray[bb_lsb(blockers)] = squares_between(king_square, square) | SQUARE_BB(square);
+		}
+	}
 
-	} else if (target_types & TARGET_ENEMY
-		&& !c->board[to.y][to.x].is_piece
-		&& to.y == ((color == WHITE) ? 5 : 2)
-		&& c->can_en_pessant[to.x][color == WHITE ? BLACK : WHITE])
-	{
-		return TARGET_EN_PESSANT | TARGET_ENEMY;
+	pieces = own & ~king;
+	while (pieces) {
+		from = bb_pop_lsb(&pieces);
+		from_bb = SQUARE_BB(from);
+
+		switch (piece_type_at(c, from, color)) {
+		case PAWN:
+			targets = bb_shift(from_bb, 0, forward) & ~c->occupied_all;
+			if (from_bb & (color == WHITE ? BB_RANK_2 : BB_RANK_7))
+				targets |= bb_shift(targets, 0, forward) & ~c->occupied_all;
+			targets |= pawn_attacks(color, from) & c->occupied[enemy];
+			break;
+		case ROOK:
+			targets = rook_attacks(from, c->occupied_all);
+			break;
+		case KNIGHT:
+			targets = knight_attacks(from);
+			break;
+		case BISHOP:
+			targets = bishop_attacks(from, c->occupied_all);
+			break;
+		case QUEEN:
+			targets = queen_attacks(from, c->occupied_all);
+			break;
+		default:
+			targets = BB_EMPTY;
+			break;
+		}
 
-	} else if (target_types & CASTLE_L
-		&& c->can_castle[LEFT][color]
-		&& c->board[(color == WHITE ? 0 : 7)][0].is_piece
-		&& !c->board[(color == WHITE ? 0 : 7)][1].is_piece
-		&& !c->board[(color == WHITE ? 0 : 7)][3].is_piece)
-	{
-		return CASTLE_L;
-
-	} else if (target_types & CASTLE_R
-		&& c->can_castle[RIGHT][color]
-		&& c->board[(color == WHITE ? 0 : 7)][7].is_piece
-		&& !c->board[(color == WHITE ? 0 : 7)][6].is_piece
-		&& !c->board[(color == WHITE ? 0 : 7)][5].is_piece
-		&& c->board[(color == WHITE ? 0 : 7)][4].is_piece)
-	{
-		return CASTLE_R;
+		PROFILE_COUNT(PROFILE_MOVES_FILTERED, bb_popcount(targets & ~own & ~(check_mask & ((pinned & from_bb) ? pin_ray[from] : ~BB_EMPTY))));
+		targets &= ~own & check_mask;
+		if (pinned & from_bb)
+			targets &= pin_ray[from];
+		add_moves_to_targets(c, moves, from, targets);
+	}
+
+	// en pessant removes two pieces from the rank, so look at the king's attackers on the board after the capture
+	if (c->en_pessant_file >= 0) {
+		to = SQUARE(c->en_pessant_file, (color == WHITE) ? 5 : 2);
+		captured = SQUARE(c->en_pessant_file, (color == WHITE) ? 4 : 3);
+		pieces = pawn_attacks(enemy, to) & c->pieces[color][PAWN];
+		while (pieces) {
+			from = bb_pop_lsb(&pieces);
+			if (!(attackers_to(c, king_square, (c->occupied_all ^ SQUARE_BB(from) ^ SQUARE_BB(captured)) | SQUARE_BB(to))
+				& c->occupied[enemy] & ~SQUARE_BB(captured)))
+			{
+				add_move(moves, MOVE(from, to, MOVE_EN_PESSANT));
+			} else {
+				PROFILE_COUNT(PROFILE_MOVES_FILTERED, 1);
+			}
+		}
+	}
 
-	} else if (target_types & TARGET_EMPTY
-			&& !c->board[to.y][to.x].is_piece)
+	// castling needs an empty path and the king may not start, pass or land on an attacked square
+	if (!checkers && c->can_castle[LEFT][color]
+		&& c->pieces[color][ROOK] & SQUARE_BB(SQUARE(0, home_rank))
+		&& !(c->occupied_all & castle_path[LEFT][color])
+		&& !square_attacked(c, SQUARE(3, home_rank), enemy)
+		&& !square_attacked(c, SQUARE(2, home_rank), enemy))
 	{
-		return TARGET_EMPTY;
-	} else {
-		return TARGET_INVALID;
+		add_move(moves, MOVE(king_square, SQUARE(2, home_rank), MOVE_CASTLE_L));
+	}
+	if (!checkers && c->can_castle[RIGHT][color]
+		&& c->pieces[color][ROOK] & SQUARE_BB(SQUARE(7, home_rank))
+		&& !(c->occupied_all & castle_path[RIGHT][color])
+		&& !square_attacked(c, SQUARE(5, home_rank), enemy)
+		&& !square_attacked(c, SQUARE(6, home_rank), enemy))
+	{
+		add_move(moves, MOVE(king_square, SQUARE(6, home_rank), MOVE_CASTLE_R));
 	}
+
+	return moves;
 }
 
-static bool add_move_if_target_valid(const chess_state *c, pos from, pos to, dllist *moves, move_target target_types)
+// adds a move from square from to each square in targets
+static void add_moves_to_targets(const chess_state *c, move_list *moves, u32 from, bitboard targets)
 {
-	move *m;
-	u8 x;
-	move_target move_type = check_target_valid(c, to, target_types);
-	piece_color color = c->active_color;
-	int tmp;
-
-	if (move_type & target_types) {
-		m = calloc(1, sizeof (move));
-		ASSERT_ERROR (m, "calloc returned NULL!");
-		memcpy(&m->before, c, sizeof (chess_state));
-		memcpy(&m->after, c, sizeof (chess_state));
-
-		if (target_types & CASTLE_L) {
-			tmp = (WHITE == color) ? 0 : 7;
-			m->after.board[tmp][0] = (piece) {.is_piece = false, .c = 0, .t = 0};
-			m->after.board[tmp][1] = (piece) {.is_piece = false, .c = 0, .t = 0};
-			m->after.board[tmp][2] = (piece) {.is_piece = true, .c = color, .t = KING};
-			m->after.board[tmp][3] = (piece) {.is_piece = true, .c = color, .t = ROOK };
-			m->after.board[tmp][4] = (piece) {.is_piece = false, .c = 0, .t = 0};
-			m->after.can_castle[LEFT][color] = false;
-			m->after.can_castle[RIGHT][color] = false;
-		} else if (target_types & CASTLE_R) {
-			tmp = (WHITE == color) ? 0 : 7;
-			m->after.board[tmp][7] = (piece) {.is_piece = false, .c = 0, .t = 0};
-			m->after.board[tmp][6] = (piece) {.is_piece = true, .c = color, .t = KING};
-			m->after.board[tmp][5] = (piece) {.is_piece = true, .c = color, .t = ROOK};
-			m->after.board[tmp][4] = (piece) {.is_piece = false, .c = 0, .t = 0};
-			m->after.can_castle[LEFT][color] = false;
-			m->after.can_castle[RIGHT][color] = false;
+	bool is_pawn = c->pieces[c->active_color][PAWN] & SQUARE_BB(from);
+	move_flag flags;
+	u32 to, promotion;
+
+	while (targets) {
+		to = bb_pop_lsb(&targets);
+		flags = (c->occupied_all & SQUARE_BB(to)) ? MOVE_CAPTURE : MOVE_QUIET;
+
+		if (is_pawn && (SQUARE_Y(to) == 0 || SQUARE_Y(to) == BOARD_SIDE_LENGTH - 1)) {
+			for (promotion = 0; promotion < 4; ++promotion) {
+				add_move(moves, MOVE(from, to, flags | MOVE_PROMOTION | promotion));
+			}
 		} else {
-			m->after.board[to.y][to.x] = m->before.board[from.y][from.x];
-			m->after.board[from.y][from.x] = (piece) {.is_piece = false, .c = 0, .t = 0};
+			if (is_pawn && (to == from + 16 || from == to + 16))
+				flags = MOVE_DOUBLE_PUSH;
+			add_move(moves, MOVE(from, to, flags));
 		}
+	}
+}
 
-		m->after.active_color = (color == WHITE) ? BLACK : WHITE;
-		memcpy(&m->from, &from, sizeof (pos));
-		memcpy(&m->to, &to, sizeof (pos));
-		m->move_type = move_type;
+static void add_move(move_list *moves, move m)
+{
+	ASSERT_DEBUG (moves->size < MOVE_LIST_CAPACITY, "Move list is full");
+	PROFILE_COUNT(PROFILE_MOVES_GENERATED, 1);
+	moves->moves[moves->size++] = m;
+}
 
-		for (x = 0; x < BOARD_SIDE_LENGTH; ++x) {
-			m->after.can_en_pessant[x][WHITE] = false;
-			m->after.can_en_pessant[x][BLACK] = false;
-		}
+// squares strictly between a and b if both share a rank, file or diagonal, else empty
+static bitboard squares_between(u32 a, u32 b)
+{
+	// with only the other square occupied, the rays from both sides meet between them
+	if (rook_attacks(a, BB_EMPTY) & SQUARE_BB(b))
+		return rook_attacks(a, SQUARE_BB(b)) & rook_attacks(b, SQUARE_BB(a));
+	if (bishop_attacks(a, BB_EMPTY) & SQUARE_BB(b))
+		return bishop_attacks(a, SQUARE_BB(b)) & bishop_attacks(b, SQUARE_BB(a));
+	return BB_EMPTY;
+}
 
-		if (2 == abs(from.y - to.y) && m->before.board[from.y][from.x].t == PAWN && m->before.board[from.y][from.x].is_piece) {
-			m->after.can_en_pessant[to.x][color] = true;
-		}
+// all pieces of both colors attacking square, sliders are blocked by occupied
+static bitboard attackers_to(const chess_state *c, u32 square, bitboard occupied)
+{
+	// a pawn attacks the square if a pawn of the other color on the square would attack the pawn
+	return (pawn_attacks(BLACK, square) & c->pieces[WHITE][PAWN])
+		| (pawn_attacks(WHITE, square) & c->pieces[BLACK][PAWN])
+		| (knight_attacks(square) & (c->pieces[WHITE][KNIGHT] | c->pieces[BLACK][KNIGHT]))
+		| (king_attacks(square) & (c->pieces[WHITE][KING] | c->pieces[BLACK][KING]))
+		| (rook_attacks(square, occupied) & (c->pieces[WHITE][ROOK] | c->pieces[BLACK][ROOK] | c->pieces[WHITE][QUEEN] | c->pieces[BLACK][QUEEN]))
+		| (bishop_attacks(square, occupied) & (c->pieces[WHITE][BISHOP] | c->pieces[BLACK][BISHOP] | c->pieces[WHITE][QUEEN] | c->pieces[BLACK][QUEEN]));
+}
 
-		if (move_type & TARGET_EN_PESSANT) {
-			m->after.board[to.y + ((color == WHITE) ? -1 : 1)][to.x] = (piece) {.is_piece = false, .c = 0, .t = 0};
-		}
+piece_type piece_type_at(const chess_state *c, u32 square, piece_color color)
+{
+	bitboard b = SQUARE_BB(square);
+	piece_type t;
+
+	for (t = 0; t < PIECE_TYPE_MAX; ++t) {
+		if (c->pieces[color][t] & b)
+			return t;
+	}
+	return PIECE_TYPE_MAX;
+}
 
-		m->after.can_castle[LEFT][WHITE] &= !(from.x == 0 && from.y == 0 || from.x == 4 && from.y == 0 || to.x == 0 && to.y == 0 || to.x == 4 && to.y == 0);
-		m->after.can_castle[LEFT][BLACK] &= !(from.x == 0 && from.y == 7 || from.x == 4 && from.y == 7 || to.x == 0 && to.y == 7 || to.x == 4 && to.y == 7);
-		m->after.can_castle[RIGHT][WHITE] &= !(from.x == 7 && from.y == 7 || from.x == 4 && from.y == 7 || to.x == 7 && to.y == 7 || to.x == 4 && to.y == 7);
-		m->after.can_castle[RIGHT][BLACK] &= !(from.x == 7 && from.y == 7 || from.x == 4 && from.y == 7 || to.x == 7 && to.y == 7 || to.x == 4 && to.y == 7);
+static void put_piece(chess_state *c, u32 square, piece_color color, piece_type t)
+{
+	bitboard b = SQUARE_BB(square);
+	c->pieces[color][t] |= b;
+	c->occupied[color] |= b;
+	c->occupied_all |= b;
+	c->key ^= zobrist_pieces[color][t][square];
+}
 
-		dllist_insert_head(moves, m);
-		return true;
+static void remove_piece(chess_state *c, u32 square, piece_color color, piece_type t)
+{
+	bitboard b = ~SQUARE_BB(square);
+	c->pieces[color][t] &= b;
+	c->occupied[color] &= b;
+	c->occupied_all &= b;
+	c->key ^= zobrist_pieces[color][t][square];
+}
+
+// part of the Zobrist key made up by castling rights and en pessant file
+static u64 rights_key(const chess_state *c)
+{
+	u64 key = 0;
+
+	if (c->can_castle[LEFT][WHITE])
+		key ^= zobrist_castle[LEFT][WHITE];
+	if (c->can_castle[LEFT][BLACK])
+		key ^= zobrist_castle[LEFT][BLACK];
+	if (c->can_castle[RIGHT][WHITE])
+		key ^= zobrist_castle[RIGHT][WHITE];
+	if (c->can_castle[RIGHT][BLACK])
+		key ^= zobrist_castle[RIGHT][BLACK];
+	if (c->en_pessant_file >= 0)
+		key ^= zobrist_en_pessant[c->en_pessant_file];
+	return key;
+}
+
+void make_move(chess_state *c, move m, move_undo *u)
+{
+	piece_color color = c->active_color;
+	piece_color enemy = (color == WHITE) ? BLACK : WHITE;
+	u32 from = move_from(m), to = move_to(m);
+	u32 home_rank = (WHITE == color) ? 0 : 7;
+	piece_type moved;
+	bitboard touched;
+
+	PROFILE_COUNT(PROFILE_MAKE_MOVES, 1);
+	memcpy(u->can_castle, c->can_castle, sizeof (c->can_castle));
+	u->en_pessant_file = c->en_pessant_file;
+	u->key = c->key;
+	u->halfmove_clock = c->halfmove_clock;
+	u->captured = PIECE_TYPE_MAX;
+	c->key ^= rights_key(c);
+
+	switch (move_flags(m)) {
+	case MOVE_CASTLE_L:
+		remove_piece(c, SQUARE(0, home_rank), color, ROOK);
+		remove_piece(c, SQUARE(4, home_rank), color, KING);
+		put_piece(c, SQUARE(2, home_rank), color, KING);
+		put_piece(c, SQUARE(3, home_rank), color, ROOK);
+		break;
+	case MOVE_CASTLE_R:
+		remove_piece(c, SQUARE(7, home_rank), color, ROOK);
+		remove_piece(c, SQUARE(4, home_rank), color, KING);
+		put_piece(c, SQUARE(6, home_rank), color, KING);
+		put_piece(c, SQUARE(5, home_rank), color, ROOK);
+		break;
+	case MOVE_EN_PESSANT:
+		u->captured = PAWN;
+		remove_piece(c, SQUARE(SQUARE_X(to), SQUARE_Y(from)), enemy, PAWN);
+		remove_piece(c, from, color, PAWN);
+		put_piece(c, to, color, PAWN);
+		break;
+	default:
+		if (move_is_capture(m)) {
+			u->captured = piece_type_at(c, to, enemy);
+			remove_piece(c, to, enemy, u->captured);
+		}
+		moved = piece_type_at(c, from, color);
+		remove_piece(c, from, color, moved);
+		put_piece(c, to, color, move_is_promotion(m) ? move_promotion(m) : moved);
+		break;
 	}
-	return false;
+
+	// only remember the file if an enemy pawn can take, so the key does not depend on a capture that cannot happen
+	c->en_pessant_file = -1;
+	if (MOVE_DOUBLE_PUSH == move_flags(m) && (c->pieces[enemy][PAWN] & (bb_shift(SQUARE_BB(to), 1, 0) | bb_shift(SQUARE_BB(to), -1, 0))))
+		c->en_pessant_file = (i8) SQUARE_X(to);
+
+	// moving or capturing a king or rook loses the castling rights on its side
+	touched = SQUARE_BB(from) | SQUARE_BB(to);
+	c->can_castle[LEFT][WHITE] &= !(touched & castle_rights_mask[LEFT][WHITE]);
+	c->can_castle[LEFT][BLACK] &= !(touched & castle_rights_mask[LEFT][BLACK]);
+	c->can_castle[RIGHT][WHITE] &= !(touched & castle_rights_mask[RIGHT][WHITE]);
+	c->can_castle[RIGHT][BLACK] &= !(touched & castle_rights_mask[RIGHT][BLACK]);
+
+	c->active_color = enemy;
+	c->fullmove_number += (color == BLACK);
+	c->key ^= rights_key(c) ^ zobrist_black_to_move;
+	c->halfmove_clock = (u->captured != PIECE_TYPE_MAX || move_is_promotion(m) || (c->pieces[color][PAWN] & SQUARE_BB(to))) ? 0 : c->halfmove_clock + 1;
 }
 
-static bool check_winning_move(const move *m) {
-	return m->before.board[m->to.y][m->to.x].c == m->after.active_color
-		&& m->before.board[m->to.y][m->to.x].t == KING
-		&& m->before.board[m->from.y][m->from.x].c != m->after.active_color;
+void unmake_move(chess_state *c, move m, const move_undo *u)
+{
+	piece_color enemy = c->active_color;
+	piece_color color = (enemy == WHITE) ? BLACK : WHITE;
+	u32 from = move_from(m), to = move_to(m);
+	u32 home_rank = (WHITE == color) ? 0 : 7;
+	piece_type moved;
+
+	switch (move_flags(m)) {
+	case MOVE_CASTLE_L:
+		remove_piece(c, SQUARE(2, home_rank), color, KING);
+		remove_piece(c, SQUARE(3, home_rank), color, ROOK);
+		put_piece(c, SQUARE(0, home_rank), color, ROOK);
+		put_piece(c, SQUARE(4, home_rank), color, KING);
+		break;
+	case MOVE_CASTLE_R:
+		remove_piece(c, SQUARE(6, home_rank), color, KING);
+		remove_piece(c, SQUARE(5, home_rank), color, ROOK);
+		put_piece(c, SQUARE(7, home_rank), color, ROOK);
+		put_piece(c, SQUARE(4, home_rank), color, KING);
+		break;
+	case MOVE_EN_PESSANT:
+		remove_piece(c, to, color, PAWN);
+		put_piece(c, from, color, PAWN);
+		put_piece(c, SQUARE(SQUARE_X(to), SQUARE_Y(from)), enemy, PAWN);
+		break;
+	default:
+		moved = piece_type_at(c, to, color);
+		remove_piece(c, to, color, moved);
+		put_piece(c, from, color, move_is_promotion(m) ? PAWN : moved);
+		if (u->captured != PIECE_TYPE_MAX)
+			put_piece(c, to, enemy, u->captured);
+		break;
+	}
 
+	memcpy(c->can_castle, u->can_castle, sizeof (c->can_castle));
+	c->en_pessant_file = u->en_pessant_file;
+	c->active_color = color;
+	c->fullmove_number -= (color == BLACK);
+	c->key = u->key;
+	c->halfmove_clock = u->halfmove_clock;
 }
 
-static move *clone_move(const move *m)
+static bool square_attacked(const chess_state *c, u32 square, piece_color attacker)
 {
-	move *m_clone;
-	ASSERT_ERROR (m, "Argument m is NULL");
-	m_clone = malloc(sizeof (move));
-	ASSERT_ERROR (m_clone, "malloc returned NULL!");
-	ASSERT_ERROR (memcpy(m_clone, m, sizeof (move)), "memcpy returned NULL");
-	return m_clone;
+	return attackers_to(c, square, c->occupied_all) & c->occupied[attacker];
 }
 
-static dllist *create_movelist(void)
+bool in_check(const chess_state *c, piece_color color)
 {
-	return dllist_init(malloc(sizeof (dllist)), clone_move, free);
-}
\ No newline at end of file
+	if (!c->pieces[color][KING])
+		return false;
+	return square_attacked(c, bb_lsb(c->pieces[color][KING]), color == WHITE ? BLACK : WHITE);
+}
+
@@ -1,6 +1,7 @@
 #ifndef CHESS_H
 #define CHESS_H
 
+#include "bitboard.h"
 #include "log.h"
 #include "types.h"
 #include "utils.h"
@@ -73,40 +74,110 @@ typedef enum {
 typedef struct {
 	piece_color active_color; /* player who is next */
 	bool can_castle[DIRECTION_MAX][COLOR_MAX]; /* keeps track who can castle on which side */
-	piece board[BOARD_SIDE_LENGTH][BOARD_SIDE_LENGTH] /* current board state */;
-	dllist allowed_moves[BOARD_SIDE_LENGTH][BOARD_SIDE_LENGTH]; /* list of allowed moves from each board position */
-	bool can_en_pessant[BOARD_SIDE_LENGTH][COLOR_MAX]; /* keeps track which pawn can be en pessanted at the moment */
+	bitboard pieces[COLOR_MAX][PIECE_TYPE_MAX]; /* one set of occupied squares per piece color and type */
+	bitboard occupied[COLOR_MAX]; /* all squares occupied by pieces of a color */
+	bitboard occupied_all; /* all squares occupied by any piece */
+	i8 en_pessant_file; /* file of the pawn which can be en pessanted at the moment, -1 if none or no enemy pawn is next to it */
+	u64 key; /* Zobrist key of the position, see zobrist.h */
+	u16 halfmove_clock; /* plies since the last capture or pawn move */
+	u16 fullmove_number; /* starts at 1 and is incremented after each move of black */
 } chess_state;
 
+#define FEN_MAX 92 /* longest FEN string written by chess_state_to_fen, including the terminating null */
+
+#define FIFTY_MOVE_PLIES 100 /* the game is drawn when the halfmove clock reaches this */
+#define POSITION_HISTORY_CAPACITY 128 /* more than FIFTY_MOVE_PLIES + 1 */
+
+/// <summary>
+/// Keys of the positions since the last irreversible move, which are the only ones the current
+/// position can repeat. A capture or pawn move empties it, so it never holds more than
+/// FIFTY_MOVE_PLIES + 1 keys and checking for repetitions takes bounded time.
+/// </summary>
+typedef struct {
+	u64 keys[POSITION_HISTORY_CAPACITY]; /* oldest first, the current position last */
+	u32 size;
+} position_history;
+
 typedef enum {
-	TARGET_ENEMY = 1 << 0,
-	TARGET_ALLY = 1 << 1,
-	TARGET_EN_PESSANT = 1 << 2,
-	TARGET_INVALID = 1 << 3,
-	TARGET_EMPTY = 1 << 4,
-	CASTLE_L = 1 << 5,
-	CASTLE_R = 1 << 6,
-} move_target;
+	MOVE_QUIET = 0,
+	MOVE_DOUBLE_PUSH = 1,
+	MOVE_CASTLE_R = 2,
+	MOVE_CASTLE_L = 3,
+	MOVE_CAPTURE = 4,
+	MOVE_EN_PESSANT = 5,
+	MOVE_PROMOTION = 8, /* bit flag, the two lowest flag bits select the new piece */
+	MOVE_PROMOTION_CAPTURE = MOVE_PROMOTION | MOVE_CAPTURE,
+} move_flag;
+
+/// <summary>
+/// packed move: bits 0-5 starting square, bits 6-11 target square, bits 12-15 move_flag.
+/// Squares are indexed as in bitboard.h.
+/// </summary>
+typedef u16 move;
+
+#define MOVE(from, to, flags) ((move) ((from) | ((to) << 6) | ((flags) << 12)))
+#define MOVE_NONE ((move) 0)
+
+static inline u32 move_from(move m) { return m & 0x3F; }
+static inline u32 move_to(move m) { return (m >> 6) & 0x3F; }
+static inline move_flag move_flags(move m) { return (move_flag) (m >> 12); }
+static inline bool move_is_capture(move m) { return (m >> 12) & MOVE_CAPTURE; }
+static inline bool move_is_promotion(move m) { return (m >> 12) & MOVE_PROMOTION; }
+
+/// <summary>
+/// Piece a pawn is promoted to. Only valid if move_is_promotion(m).
+/// </summary>
+static inline piece_type move_promotion(move m)
+{
+	static const piece_type t[] = { KNIGHT, BISHOP, ROOK, QUEEN };
+	return t[(m >> 12) & 3];
+}
+
+#define MOVE_LIST_CAPACITY 256
+
+/// <summary>
+/// Contiguous list of moves. Fixed size, so it can be put on the stack.
+/// </summary>
+typedef struct {
+	move moves[MOVE_LIST_CAPACITY];
+	u32 size;
+} move_list;
+
+/// <summary>
+/// Everything make_move overwrites and unmake_move needs to restore a chess_state
+/// </summary>
+typedef struct {
+	piece_type captured; /* type of the captured piece, PIECE_TYPE_MAX if the move was no capture */
+	bool can_castle[DIRECTION_MAX][COLOR_MAX]; /* castling rights before the move */
+	i8 en_pessant_file; /* en pessant file before the move */
+	u64 key; /* Zobrist key before the move */
+	u16 halfmove_clock; /* halfmove clock before the move */
+} move_undo;
+
+#define GAME_CHECKPOINT_INTERVAL 32 /* plies between two states stored in a game_record */
 
 /// <summary>
-/// move structure
+/// Moves of a game in playing order, 2 bytes each. The state before every
+/// GAME_CHECKPOINT_INTERVAL-th move is stored as well, so any ply can be restored
+/// by replaying less than GAME_CHECKPOINT_INTERVAL moves from a checkpoint.
+/// Undone moves stay recorded for redo until a different move is played.
 /// </summary>
 typedef struct {
-	chess_state before; /* game state before move */
-	chess_state after; /* game state after move */
-	pos from; /* to be moved piece starting position */
-	pos to; /* moved piece position after move */
-	move_target move_type; /* move_target bitmap with containing the type of move*/
-} move;
+	vector moves; /* recorded moves, including undone ones */
+	vector checkpoints; /* chess_state, element i is the state before move i * GAME_CHECKPOINT_INTERVAL */
+	u32 ply; /* number of moves leading to the current state */
+} game_record;
 
 /// <summary>
 /// chess game structe 
 /// </summary>
 typedef struct {
-	dllist history; /* list of played moves */
+	game_record record; /* played moves, for takeback and seeking */
 	chess_state current_state; /* current game state */
+	move_list allowed_moves; /* legal moves in current_state */
+	position_history positions; /* keys since the last irreversible move, for repetition detection */
 	bool is_game_over; /* true if game is over */
-	bool is_draw; /* true if game ended in draw */
+	bool is_draw; /* true if game ended in draw: stalemate, threefold repetition or fifty-move rule */
 	piece_color winner; /* contains the winning color if is_draw is false */
 } chess;
 
@@ -117,13 +188,43 @@ typedef struct {
 /// <returns></returns>
 chess * init_chess(chess *c);
 
+/// <summary>
+/// Initializes chess struct with a position in Forsyth-Edwards notation
+/// </summary>
+/// <param name="c">chess structure to be inintialized</param>
+/// <param name="fen">FEN string</param>
+/// <returns>false if the FEN string could not be parsed, c is not initialized then</returns>
+bool init_chess_from_fen(chess *c, const char *fen);
+
+/// <summary>
+/// Start a new game from a state, reusing the memory of the game record of an initialized chess struct
+/// </summary>
+/// <param name="c">chess structure initialized by init_chess or init_chess_from_fen</param>
+/// <param name="s">starting state of the new game</param>
+void restart_chess(chess *c, const chess_state *s);
+
+/// <summary>
+/// Frees the game record of a chess struct initialized by init_chess or init_chess_from_fen
+/// </summary>
+/// <param name="c">chess structure</param>
+void free_chess(chess *c);
+
 /// <summary>
 /// Get all valid moves from the active color from the specified position.
 /// </summary>
 /// <param name="c">chess struct with current game state</param>
 /// <param name="p">starting pos of moves</param>
-/// <returns>list of moves from pos p</returns>
-const dllist * valid_moves_from(const chess *c, pos p);
+/// <param name="moves">list to be filled</param>
+/// <returns>moves, containing the moves from pos p</returns>
+move_list * valid_moves_from(const chess *c, pos p, move_list *moves);
+
+/// <summary>
+/// Generate all legal moves of the active color
+/// </summary>
+/// <param name="c">game state</param>
+/// <param name="moves">list to be filled</param>
+/// <returns>moves</returns>
+move_list *generate_moves(const chess_state *c, move_list *moves);
 
 /// <summary>
 /// Check if move if valid and if so, do the move
@@ -134,6 +235,146 @@ const dllist * valid_moves_from(const chess *c, pos p);
 /// <returns>true if move is valid and applied, else false</returns>
 bool try_move(chess *c, pos from, pos to);
 
+/// <summary>
+/// Play a move if it is legal in the current game state
+/// </summary>
+/// <param name="c">chess struct with current game state</param>
+/// <param name="m">move, e.g. chosen by search</param>
+/// <returns>true if move is valid and applied, else false</returns>
+bool play_move(chess *c, move m);
+
+/// <summary>
+/// Take back the last move. It stays recorded for redo_move.
+/// </summary>
+/// <param name="c">chess struct with current game state</param>
+/// <returns>false if no move was played</returns>
+bool undo_move(chess *c);
+
+/// <summary>
+/// Play the move taken back last again
+/// </summary>
+/// <param name="c">chess struct with current game state</param>
+/// <returns>false if there is no move to redo</returns>
+bool redo_move(chess *c);
+
+/// <summary>
+/// Restore the game state after a number of recorded moves. Replays at most
+/// GAME_CHECKPOINT_INTERVAL + FIFTY_MOVE_PLIES moves, whatever the length of the game.
+/// </summary>
+/// <param name="c">chess struct with current game state</param>
+/// <param name="ply">number of moves from the start position, up to the number of recorded moves</param>
+/// <returns>false if ply is out of range</returns>
+bool seek_ply(chess *c, u32 ply);
+
+
+/// <summary>
+/// Play a move on the game state in place. The move has to be valid for the state!
+/// </summary>
+/// <param name="c">game state to be updated</param>
+/// <param name="m">move to be played</param>
+/// <param name="u">receives the information needed to take the move back</param>
+void make_move(chess_state *c, move m, move_undo *u);
+
+/// <summary>
+/// Take back the last move played with make_move on the game state
+/// </summary>
+/// <param name="c">game state to be restored</param>
+/// <param name="m">move passed to make_move</param>
+/// <param name="u">undo information filled by make_move</param>
+void unmake_move(chess_state *c, move m, const move_undo *u);
+
+/// <summary>
+/// Start a position history with the given state
+/// </summary>
+/// <param name="h">history to reset</param>
+/// <param name="c">current game state</param>
+void position_history_init(position_history *h, const chess_state *c);
+
+/// <summary>
+/// Append the state after a move. Empties the history first if the move was irreversible.
+/// </summary>
+/// <param name="h">history up to the previous state</param>
+/// <param name="c">game state after the move</param>
+void position_history_push(position_history *h, const chess_state *c);
+
+/// <summary>
+/// Number of times the last position in the history occurred before
+/// </summary>
+/// <param name="h">history</param>
+/// <returns>0 for a new position, 2 for a threefold repetition</returns>
+u32 position_history_repetitions(const position_history *h);
+
+/// <summary>
+/// Check if the king of a color is attacked
+/// </summary>
+/// <param name="c">game state</param>
+/// <param name="color">color of the king</param>
+/// <returns>true if the king is in check</returns>
+bool in_check(const chess_state *c, piece_color color);
+
+/// <summary>
+/// Type of the piece of a color on a square
+/// </summary>
+/// <param name="c">game state</param>
+/// <param name="square">square index as in bitboard.h</param>
+/// <param name="color">color of the piece</param>
+/// <returns>piece type or PIECE_TYPE_MAX if there is no piece of that color</returns>
+piece_type piece_type_at(const chess_state *c, u32 square, piece_color color);
+
+/// <summary>
+/// Get the piece standing on a board position
+/// </summary>
+/// <param name="c">game state</param>
+/// <param name="p">board position</param>
+/// <returns>piece on p, is_piece is false if p is empty</returns>
+piece piece_at(const chess_state *c, pos p);
+
+/// <summary>
+/// Load a game state from a position in Forsyth-Edwards Notation.
+/// Move counters at the end of the string are optional, they default to 0 and 1.
+/// </summary>
+/// <param name="c">game state to be overwritten, left untouched if fen is invalid</param>
+/// <param name="fen">FEN string</param>
+/// <returns>true if fen was valid and loaded, else false</returns>
+bool chess_state_from_fen(chess_state *c, const char *fen);
+
+/// <summary>
+/// Write a game state in Forsyth-Edwards Notation, including both move counters
+/// </summary>
+/// <param name="c">game state</param>
+/// <param name="out">buffer with at least FEN_MAX chars</param>
+/// <returns>out</returns>
+char *chess_state_to_fen(const chess_state *c, char *out);
+
+/// <summary>
+/// Parse a legal move in standard algebraic notation (e.g. "Nbd7", "exd8=Q+", "O-O")
+/// or coordinate notation (e.g. "e7e8q"). Check and annotation suffixes are skipped.
+/// </summary>
+/// <param name="c">game state the move is played in</param>
+/// <param name="s">text starting with the move</param>
+/// <param name="m">receives the move</param>
+/// <param name="end">receives the first char after the move and its suffixes, may be NULL</param>
+/// <returns>false if s does not start with a legal move or the move is ambiguous</returns>
+bool parse_move(const chess_state *c, const char *s, move *m, const char **end);
+
+/// <summary>
+/// parse_move with the legal moves of c already generated, e.g. chess.allowed_moves
+/// </summary>
+/// <param name="c">game state the move is played in</param>
+/// <param name="moves">all legal moves in c</param>
+/// <param name="s">text starting with the move</param>
+/// <param name="m">receives the move</param>
+/// <param name="end">receives the first char after the move and its suffixes, may be NULL</param>
+/// <returns>false if s does not start with one of the moves or the move is ambiguous</returns>
+bool parse_move_in_list(const chess_state *c, const move_list *moves, const char *s, move *m, const char **end);
+
+/// <summary>
+/// Write a move in coordinate notation (e.g. "e2e4", "e7e8q") to out
+/// </summary>
+/// <param name="m">move</param>
+/// <param name="out">buffer with at least 6 chars</param>
+/// <returns>out</returns>
+char *move_to_string(move m, char *out);
 
 /// <summary>
 /// Print move to log file and console
@@ -1,25 +1,126 @@
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include "attacks.h"
+#include "bitbase.h"
+#include "book.h"
 #include "chess.h"
+#include "epd.h"
 #include "log.h"
+#include "mem.h"
+#include "perft.h"
+#include "pgn.h"
+#include "search.h"
+#include "tt.h"
 #include "utils.h"
+#include "zobrist.h"
+
+// walks the move tree and compares the incrementally updated key with a freshly computed one
+static void check_keys(chess_state *c, u32 depth)
+{
+	move_list moves;
+	move_undo u;
+	u64 key = c->key;
+	u32 i;
+
+	ASSERT_ERROR (zobrist_key(c) == c->key, "Error: incremental Zobrist key differs from computed key");
+	if (depth == 0)
+		return;
+
+	generate_moves(c, &moves);
+	for (i = 0; i < moves.size; ++i) {
+		make_move(c, moves.moves[i], &u);
+		check_keys(c, depth - 1);
+		unmake_move(c, moves.moves[i], &u);
+		ASSERT_ERROR (c->key == key, "Error: unmake_move did not restore the Zobrist key");
+	}
+}
+
+static bool is_even(void *data)
+{
+	return *(u32 *) data % 2 == 0;
+}
+
+static bool is_999(const void *data)
+{
+	return *(const u32 *) data == 999;
+}
 
 int tests()
 {
 	chess c;
 	pos p;
 	u64 cnt = 0;
-	const dllist *moves;
+	u32 i;
+	move_list moves;
+	chess_state state;
+	u64 nodes;
+	transposition_table tt;
+	tt_data data;
+	search_result result;
+	u64 keys[201];
+	dllist_allocator allocator;
+	dllist list, *duplicate;
+	vector numbers;
+	mem_stats containers, stats;
+	log_site site = { "HelloWorldSDL/chess_test.c", 0 };
+	arena_block *last_block = NULL;
+	char fen[FEN_MAX];
+	const char *end;
+	move m;
+	FILE *f;
+	pgn_summary games;
+	epd_summary suite;
+	book_entry entries[4];
+	opening_book book;
+	book_move book_moves[4];
+	u64 entry_num = 4;
+	volatile u32 stop = 1;
+	static const struct {
+		const char *fen;
+		bitbase_result result;
+		piece_color winner;
+	} bitbase_positions[] = {
+		{ "k7/8/8/8/8/8/P7/K7 w - - 0 1", BITBASE_DRAW, WHITE }, /* the king stands in front of a rook pawn */
+		{ "7k/8/8/8/8/8/P7/K7 w - - 0 1", BITBASE_WIN, WHITE }, /* the king is outside the square of the pawn */
+		{ "k7/p7/8/8/8/8/8/7K b - - 0 1", BITBASE_WIN, BLACK },
+		{ "4k3/8/8/8/8/8/8/3QK3 b - - 0 1", BITBASE_WIN, WHITE },
+		{ "k7/2Q5/1K6/8/8/8/8/8 b - - 0 1", BITBASE_DRAW, WHITE }, /* stalemate */
+		{ "8/8/8/8/8/8/kR6/7K b - - 0 1", BITBASE_DRAW, WHITE }, /* the rook is lost */
+		{ "8/8/8/8/8/8/8/k1K4r w - - 0 1", BITBASE_WIN, BLACK }, /* the rook is out of reach */
+		{ "4k3/8/8/8/8/8/8/2B1K3 w - - 0 1", BITBASE_DRAW, WHITE },
+		{ "4k3/8/8/8/8/8/8/R3K3 w Q - 0 1", BITBASE_NONE, WHITE },
+		{ "4k3/8/8/8/8/8/1P6/R3K3 w - - 0 1", BITBASE_NONE, WHITE },
+	};
+	static const struct {
+		const char *moves;
+		u64 key;
+	} polyglot_keys[] = { /* reference keys of the Polyglot book format */
+		{ "", 0x463B96181691FC9CULL },
+		{ "e2e4", 0x823C9B50FD114196ULL },
+		{ "e2e4 d7d5", 0x0756B94461C50FB0ULL },
+		{ "e2e4 d7d5 e4e5", 0x662FAFB965DB29D4ULL },
+		{ "e2e4 d7d5 e4e5 f7f5", 0x22A48B5A8E47FF78ULL },
+		{ "e2e4 d7d5 e4e5 f7f5 e1e2", 0x652A607CA3F242C1ULL },
+		{ "e2e4 d7d5 e4e5 f7f5 e1e2 e8f7", 0x00FDD303C946BDD9ULL },
+		{ "a2a4 b7b5 h2h4 b5b4 c2c4", 0x3C8123EA7B067637ULL },
+		{ "a2a4 b7b5 h2h4 b5b4 c2c4 b4c3 a1a3", 0x5C3F9B829B279560ULL },
+	};
+	piece_color winner;
+	u32 j;
 
 	init_chess(&c);
 
 	for (p.y = 0; p.y < BOARD_SIDE_LENGTH; ++p.y) {
 		for (p.x = 0; p.x < BOARD_SIDE_LENGTH; ++p.x) {
-			moves = valid_moves_from(&c, p);
-			cnt += dllist_size(moves);
-			if (dllist_size(moves) > 0) {
-				printf("Number of valid moves starting from (%hhu,%hhu): %llu\n", p.x, p.y, dllist_size(moves));
-				dllist_apply((dllist *)moves, print_move);
+			valid_moves_from(&c, p, &moves);
+			cnt += moves.size;
+			if (moves.size > 0) {
+				printf("Number of valid moves starting from (%hhu,%hhu): %u\n", p.x, p.y, moves.size);
+				for (i = 0; i < moves.size; ++i)
+					print_move(&moves.moves[i]);
 			}
 		}
 	}
@@ -36,11 +137,12 @@ int tests()
 
 	for (p.y = 0; p.y < BOARD_SIDE_LENGTH; ++p.y) {
 		for (p.x = 0; p.x < BOARD_SIDE_LENGTH; ++p.x) {
-			moves = valid_moves_from(&c, p);
-			cnt += dllist_size(moves);
-			if (dllist_size(moves) > 0) {
-				printf("Number of valid moves starting from (%hhu,%hhu): %llu\n", p.x, p.y, dllist_size(moves));
-				dllist_apply((dllist *) moves, print_move);
+			valid_moves_from(&c, p, &moves);
+			cnt += moves.size;
+			if (moves.size > 0) {
+				printf("Number of valid moves starting from (%hhu,%hhu): %u\n", p.x, p.y, moves.size);
+				for (i = 0; i < moves.size; ++i)
+					print_move(&moves.moves[i]);
 			}
 		}
 	}
@@ -57,15 +159,239 @@ int tests()
 
 	for (p.y = 0; p.y < BOARD_SIDE_LENGTH; ++p.y) {
 		for (p.x = 0; p.x < BOARD_SIDE_LENGTH; ++p.x) {
-			moves = valid_moves_from(&c, p);
-			cnt += dllist_size(moves);
-			if (dllist_size(moves) > 0) {
-				printf("Number of valid moves starting from (%hhu,%hhu): %llu\n", p.x, p.y, dllist_size(moves));
-				dllist_apply((dllist *) moves, print_move);
+			valid_moves_from(&c, p, &moves);
+			cnt += moves.size;
+			if (moves.size > 0) {
+				printf("Number of valid moves starting from (%hhu,%hhu): %u\n", p.x, p.y, moves.size);
+				for (i = 0; i < moves.size; ++i)
+					print_move(&moves.moves[i]);
 			}
 		}
 	}
 	LOG_INFO ("Total number of allowed moves: %llu", cnt);
-	ASSERT_ERROR (18 == cnt, "Error: expected 18 moves, got %d", cnt);
+	ASSERT_ERROR (20 == cnt, "Error: expected 20 moves, got %d", cnt);
+
+	for (i = 0; i < perft_position_num; ++i) {
+		ASSERT_ERROR (chess_state_from_fen(&state, perft_positions[i].fen), "Error: could not parse %s", perft_positions[i].fen);
+		nodes = perft(&state, 3);
+		LOG_INFO ("perft(3) of %s: %llu", perft_positions[i].name, nodes);
+		ASSERT_ERROR (perft_positions[i].nodes[2] == nodes, "Error: perft(3) of %s expected %llu, got %llu", perft_positions[i].name, perft_positions[i].nodes[2], nodes);
+		check_keys(&state, 3);
+		// magic and PEXT lookups must agree
+		attacks_set_pext(!attacks_use_pext);
+		nodes = perft(&state, 3);
+		attacks_set_pext(true);
+		ASSERT_ERROR (perft_positions[i].nodes[2] == nodes, "Error: perft(3) of %s with other slider lookup expected %llu, got %llu", perft_positions[i].name, perft_positions[i].nodes[2], nodes);
+		nodes = perft_parallel(&state, 3, 4, NULL, NULL);
+		ASSERT_ERROR (perft_positions[i].nodes[2] == nodes, "Error: parallel perft(3) of %s expected %llu, got %llu", perft_positions[i].name, perft_positions[i].nodes[2], nodes);
+		ASSERT_ERROR (!strcmp(chess_state_to_fen(&state, fen), perft_positions[i].fen), "Error: FEN of %s written as %s", perft_positions[i].name, fen);
+	}
+
+	// standard algebraic and coordinate notation, suffixes are skipped
+	ASSERT_ERROR (chess_state_from_fen(&state, perft_positions[1].fen), "Error: could not parse %s", perft_positions[1].fen);
+	ASSERT_ERROR (parse_move(&state, "O-O-O+ Nxf7", &m, &end) && m == MOVE(SQUARE(4, 0), SQUARE(2, 0), MOVE_CASTLE_L) && !strcmp(end, " Nxf7"),
+		"Error: castling not parsed");
+	ASSERT_ERROR (parse_move(&state, "Nxf7!?", &m, &end) && m == MOVE(SQUARE(4, 4), SQUARE(5, 6), MOVE_CAPTURE) && !*end, "Error: knight capture not parsed");
+	ASSERT_ERROR (parse_move(&state, "dxe6", &m, NULL) && parse_move(&state, "e2a6", &m, NULL) && m == MOVE(SQUARE(4, 1), SQUARE(0, 5), MOVE_CAPTURE),
+		"Error: pawn capture or coordinate move not parsed");
+	ASSERT_ERROR (!parse_move(&state, "Qg6", &m, NULL) && !parse_move(&state, "e4e5", &m, NULL), "Error: illegal move parsed");
+	ASSERT_ERROR (chess_state_from_fen(&state, "4k3/P7/8/8/8/8/8/4K3 w - - 3 41") && parse_move(&state, "a8=R+", &m, NULL)
+		&& m == MOVE(SQUARE(0, 6), SQUARE(0, 7), MOVE_PROMOTION | 2) && state.fullmove_number == 41, "Error: promotion not parsed");
+	make_move(&state, m, &(move_undo) { 0 });
+	ASSERT_ERROR (!strcmp(chess_state_to_fen(&state, fen), "R3k3/8/8/8/8/8/8/4K3 b - - 0 41"), "Error: FEN after promotion is %s", fen);
+	ASSERT_ERROR (epd_parse_position(&state, "4k3/8/8/8/8/8/8/4K2R w K - hmvc 7; fmvn 30; c0 \"a;bm\"; bm Rh8+;", &end)
+		&& state.halfmove_clock == 7 && state.fullmove_number == 30 && !strcmp(epd_find_operation(end, "bm"), "Rh8+;"),
+		"Error: EPD operations not found");
+
+	// a perft line without a D operation has nothing to count unless a depth is given
+	f = fopen("test.epd", "w");
+	ASSERT_ERROR (f, "Error: could not create test.epd");
+	fputs("4k3/8/8/8/8/8/8/4K2R w K - ;D1 15 ;D2 66\n4k3/8/8/8/8/8/8/4K2R w K - bm Rh8+;\n", f);
+	fclose(f);
+	ASSERT_ERROR (epd_run("test.epd", &(epd_options) { EPD_PERFT, 1, 0, 0, 0 }, NULL, NULL, &suite)
+		&& suite.passed == 1 && suite.invalid == 1 && suite.failed == 0, "Error: perft line without depth not reported as invalid");
+	ASSERT_ERROR (epd_run("test.epd", &(epd_options) { EPD_PERFT, 1, 1, 0, 0 }, NULL, NULL, &suite)
+		&& suite.passed == 2 && suite.nodes == 30, "Error: perft line without depth not counted to the limit");
+	remove("test.epd");
+
+	// a mate with the wrong result, an illegal king move and a broken FEN tag among games with variations and comments
+	f = fopen("test.pgn", "w");
+	ASSERT_ERROR (f, "Error: could not create test.pgn");
+	fputs("[Event \"a\"]\n[Result \"0-1\"]\n\n1. f3 e5 2. g4?? (2. e4 {(} (2... d5)) 2... Qh4# 0-1\n\n"
+		"[Event \"b\"]\n\n1. f3 e5 2. g4 Qh4# 1/2-1/2\n\n[Event \"c\"]\n\n1. e4 e5 2. Ke3 *\n\n"
+		"[Event \"d\"]\n[FEN \"4k3/8/8/8/8/8/8/R3K3 w Q - 0 1\"]\n\n1. O-O-O Kf7 $1 2. Rd7+ Ke6 ; comment\n3. Ra7 1-0\n\n"
+		"[Event \"e\"]\n[FEN \"4k3/8/8 w - - 0 1\"]\n\n*\n", f);
+	fclose(f);
+	ASSERT_ERROR (pgn_replay("test.pgn", 2, NULL, NULL, NULL, &games) && games.games == 5 && games.plies == 15
+		&& games.illegal == 1 && games.wrong_result == 1 && games.invalid == 1, "Error: replayed %llu games with %llu plies", games.games, games.plies);
+
+	// the first line after the slice boundary is inside a comment and looks like a tag
+	f = fopen("test.pgn", "wb");
+	ASSERT_ERROR (f, "Error: could not create test.pgn");
+	for (cnt = 0; ftell(f) + 200 < PGN_SLICE_BYTES; ++cnt)
+		fputs("[Event \"a\"]\n\n1. e4 e5 {comment\n[%clk 0:01:00]} 2. Nf3 Nc6 3. Bc4 *\n\n", f);
+	for (i = (u32) ftell(f); i < PGN_SLICE_BYTES - 20; ++i)
+		fputc(i + 1 < PGN_SLICE_BYTES - 20 ? ';' : '\n', f);
+	for (i = 0; i < 100; ++i, ++cnt)
+		fputs("[Event \"a\"]\n\n1. e4 e5 {comment\n[%clk 0:01:00]} 2. Nf3 Nc6 3. Bc4 *\n\n", f);
+	fclose(f);
+	ASSERT_ERROR (pgn_replay("test.pgn", 2, NULL, NULL, NULL, &games) && games.games == cnt && games.plies == 5 * cnt && games.illegal == 0,
+		"Error: game split at a slice boundary, replayed %llu of %llu games", games.games, cnt);
+	remove("test.pgn");
+
+	for (j = 0; j < sizeof (polyglot_keys) / sizeof (polyglot_keys[0]); ++j) {
+		ASSERT_ERROR (chess_state_from_fen(&state, perft_positions[0].fen), "Error: could not parse %s", perft_positions[0].fen);
+		for (end = polyglot_keys[j].moves; *end; end += *end == ' ') {
+			ASSERT_ERROR (parse_move(&state, end, &m, &end), "Error: could not parse %s", end);
+			make_move(&state, m, &(move_undo) { 0 });
+		}
+		ASSERT_ERROR (polyglot_key(&state) == polyglot_keys[j].key, "Error: wrong Polyglot key after \"%s\"", polyglot_keys[j].moves);
+	}
+
+	// duplicate entries are merged, castling is stored as the king taking its rook, zero weights are never picked
+	ASSERT_ERROR (chess_state_from_fen(&state, perft_positions[1].fen), "Error: could not parse %s", perft_positions[1].fen);
+	entries[0] = (book_entry) { polyglot_key(&state), book_encode_move(MOVE(SQUARE(4, 0), SQUARE(6, 0), MOVE_CASTLE_R)), 3, 0 };
+	entries[1] = (book_entry) { polyglot_key(&state) + 1, book_encode_move(MOVE(SQUARE(4, 0), SQUARE(5, 0), MOVE_QUIET)), 5, 0 };
+	entries[2] = (book_entry) { polyglot_key(&state), book_encode_move(MOVE(SQUARE(3, 1), SQUARE(7, 5), MOVE_QUIET)), 0, 0 };
+	entries[3] = entries[0];
+	ASSERT_ERROR (entries[0].move == (SQUARE(7, 0) | SQUARE(4, 0) << 6), "Error: castling encoded as %hu", entries[0].move);
+	ASSERT_ERROR (book_write("test.book", entries, &entry_num) && entry_num == 3 && book_open(&book, "test.book") && book.entry_num == 3
+		&& book.size == 3 * BOOK_ENTRY_SIZE, "Error: book not written");
+	ASSERT_ERROR (book_probe(&book, &state, book_moves, 4) == 2 && book_moves[0].m == MOVE(SQUARE(4, 0), SQUARE(6, 0), MOVE_CASTLE_R)
+		&& book_moves[0].weight == 6 && book_moves[1].weight == 0, "Error: book probe failed");
+	for (i = 0; i < 10; ++i)
+		ASSERT_ERROR (book_pick(&book, &state, i) == book_moves[0].m, "Error: book picked a move of weight 0");
+	book_close(&book);
+	// a truncated entry is no book
+	f = fopen("test.book", "ab");
+	fputc(0, f);
+	fclose(f);
+	ASSERT_ERROR (!book_open(&book, "test.book"), "Error: truncated book opened");
+	remove("test.book");
+
+	// the second time the file written the first time is mapped
+	for (i = 0; i < 2; ++i) {
+		ASSERT_ERROR (bitbases_init("test_bitbases.bin", 2), "Error: bitbases not saved");
+		for (j = 0; j < sizeof (bitbase_positions) / sizeof (bitbase_positions[0]); ++j) {
+			ASSERT_ERROR (chess_state_from_fen(&state, bitbase_positions[j].fen), "Error: could not parse %s", bitbase_positions[j].fen);
+			winner = WHITE;
+			ASSERT_ERROR (bitbase_probe(&state, &winner) == bitbase_positions[j].result && winner == bitbase_positions[j].winner,
+				"Error: wrong bitbase result for %s", bitbase_positions[j].fen);
+		}
+		bitbases_free();
+	}
+	remove("test_bitbases.bin");
+
+	ASSERT_ERROR (sizeof (tt_entry) == 16, "Error: tt_entry has %u bytes", (u32) sizeof (tt_entry));
+	ASSERT_ERROR (tt_init(&tt, 1), "Error: tt_init failed");
+	ASSERT_ERROR (!((uintptr_t) tt.entries % TT_ALIGNMENT), "Error: buckets are not cache line aligned");
+	ASSERT_ERROR (!tt_probe(&tt, c.current_state.key, &data), "Error: empty table returned an entry");
+	tt_store(&tt, c.current_state.key, &(tt_data) { MOVE(12, 28, MOVE_DOUBLE_PUSH), -150, 5, BOUND_EXACT });
+	ASSERT_ERROR (tt_probe(&tt, c.current_state.key, &data), "Error: stored entry not found");
+	ASSERT_ERROR (data.best_move == MOVE(12, 28, MOVE_DOUBLE_PUSH) && data.score == -150 && data.depth == 5 && data.bound == BOUND_EXACT,
+		"Error: entry changed in the table");
+	// keys in the same bucket, the deepest entries survive
+	for (i = 1; i <= TT_BUCKET_SIZE; ++i)
+		tt_store(&tt, c.current_state.key + i * (tt.mask + 1), &(tt_data) { MOVE_NONE, 0, (u8) i, BOUND_LOWER });
+	ASSERT_ERROR (tt_probe(&tt, c.current_state.key, &data), "Error: deep entry was replaced by a shallow one");
+	ASSERT_ERROR (!tt_probe(&tt, c.current_state.key + (tt.mask + 1), &data), "Error: shallowest entry was not replaced");
+	tt_free(&tt);
+
+	ASSERT_ERROR (tt_init(&tt, 16), "Error: tt_init failed");
+	ASSERT_ERROR (chess_state_from_fen(&state, "6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1"), "Error: could not parse mate in one");
+	search(&state, NULL, &tt, &(search_limits) { 4, 0, 0, NULL }, &result);
+	ASSERT_ERROR (result.best_move == MOVE(SQUARE(0, 0), SQUARE(0, 7), MOVE_QUIET) && result.score == SCORE_MATE - 1,
+		"Error: search did not find the mate in one, got move %hu with score %d", result.best_move, result.score);
+	search(&c.current_state, &c.positions, &tt, &(search_limits) { 0, 0, 20000, NULL }, &result);
+	ASSERT_ERROR (result.depth > 0 && play_move(&c, result.best_move), "Error: search returned no legal move");
+	// without limits only the stop flag ends the search
+	search(&c.current_state, &c.positions, &tt, &(search_limits) { 0, 0, 0, &stop }, &result);
+	ASSERT_ERROR (result.nodes < 100000 && play_move(&c, result.best_move), "Error: search was not stopped, %llu nodes", result.nodes);
+	tt_free(&tt);
+
+	// knights shuffling back and forth, the start position occurs for the third time after two rounds
+	free_chess(&c);
+	init_chess(&c);
+	for (i = 0; i < 8; ++i) {
+		static const move shuffle[4] = { MOVE(6, 21, MOVE_QUIET), MOVE(57, 42, MOVE_QUIET), MOVE(21, 6, MOVE_QUIET), MOVE(42, 57, MOVE_QUIET) };
+		ASSERT_ERROR (!c.is_game_over, "Error: game ended after %u moves of the knight shuffle", i);
+		ASSERT_ERROR (play_move(&c, shuffle[i % 4]), "Error: knight shuffle move %u was illegal", i);
+	}
+	ASSERT_ERROR (c.is_game_over && c.is_draw, "Error: threefold repetition was not detected");
+	ASSERT_ERROR (undo_move(&c) && !c.is_game_over, "Error: game still over after takeback");
+	ASSERT_ERROR (redo_move(&c) && c.is_game_over && c.is_draw && !redo_move(&c), "Error: redo did not repeat the position");
+	free_chess(&c);
+	ASSERT_ERROR (init_chess_from_fen(&c, "4k3/8/8/8/8/8/8/R3K3 w - - 99 80"), "Error: could not parse halfmove clock");
+	ASSERT_ERROR (play_move(&c, MOVE(SQUARE(0, 0), SQUARE(0, 1), MOVE_QUIET)) && c.is_game_over && c.is_draw, "Error: fifty-move rule was not applied");
+	free_chess(&c);
+
+	// a game spanning several checkpoints, every ply has to be restored exactly
+	init_chess(&c);
+	for (i = 0; i < 200 && !c.is_game_over; ++i) {
+		keys[i] = c.current_state.key;
+		play_move(&c, c.allowed_moves.moves[(i * 7) % c.allowed_moves.size]);
+	}
+	keys[i] = c.current_state.key;
+	ASSERT_ERROR (vector_size(&c.record.moves) == i && c.record.ply == i, "Error: game record has %llu of %u moves", vector_size(&c.record.moves), i);
+	for (cnt = i; cnt-- > 0;)
+		ASSERT_ERROR (undo_move(&c) && c.current_state.key == keys[cnt], "Error: takeback to ply %llu restored another position", cnt);
+	ASSERT_ERROR (!undo_move(&c), "Error: takeback before the first move");
+	ASSERT_ERROR (seek_ply(&c, i) && c.current_state.key == keys[i] && c.is_game_over == (i < 200), "Error: seeking to the end failed");
+	ASSERT_ERROR (seek_ply(&c, i / 3) && c.current_state.key == keys[i / 3] && !seek_ply(&c, i + 1), "Error: seeking failed");
+	ASSERT_ERROR (redo_move(&c) && c.current_state.key == keys[i / 3 + 1] && vector_size(&c.record.moves) == i, "Error: redo failed");
+	free_chess(&c);
+
+	// lists in an allocator reuse the same memory after a reset
+	dllist_allocator_init(&allocator);
+	for (cnt = 0; cnt < 2; ++cnt) {
+		dllist_init_allocator(&list, sizeof (u32), &allocator);
+		for (i = 0; i < 10000; ++i)
+			dllist_insert_tail(&list, &i);
+		ASSERT_ERROR (dllist_size(&list) == 10000 && dllist_exists(&list, is_999), "Error: list in allocator lost elements");
+		dllist_filter(&list, is_even);
+		duplicate = dllist_duplicate(&list);
+		ASSERT_ERROR (dllist_size(duplicate) == 5000 && !dllist_exists(duplicate, is_999) && *(u32 *) duplicate->tail->data == 9998,
+			"Error: filtering or duplicating a list in an allocator failed");
+		free(duplicate);
+		if (cnt == 0)
+			for (last_block = allocator.memory.first; last_block->next; last_block = last_block->next);
+		else
+			ASSERT_ERROR (!last_block->next, "Error: allocator did not reuse its memory");
+		dllist_allocator_reset(&allocator);
+	}
+	dllist_allocator_free(&allocator);
+
+	vector_init(&numbers, sizeof (u32));
+	for (i = 0; i < 10000; ++i)
+		vector_push(&numbers, &i);
+	vector_filter(&numbers, is_even);
+	ASSERT_ERROR (vector_size(&numbers) == 5000 && *(u32 *) vector_at(&numbers, 4999) == 9998 && !vector_exists(&numbers, is_999),
+		"Error: vector_filter kept the wrong elements");
+	vector_free(&numbers);
+
+	// owned payloads are freed by the list, the game record is released by free_chess
+	mem_get_stats(MEM_CONTAINERS, &containers);
+	dllist_init(&list, NULL, free);
+	for (i = 0; i < 100; ++i) {
+		duplicate = malloc(sizeof (u32));
+		*(u32 *) duplicate = i;
+		dllist_insert_head_owned(&list, duplicate);
+	}
+	ASSERT_ERROR (dllist_size(&list) == 100 && *(u32 *) list.head->data == 99, "Error: owned inserts failed");
+	dllist_clear_elems(&list);
+	ASSERT_ERROR (mem_get_stats(MEM_CONTAINERS, &stats)->live_bytes == containers.live_bytes && stats.live_allocations == containers.live_allocations,
+		"Error: %llu bytes of list elements are left", stats.live_bytes - containers.live_bytes);
+	init_chess(&c);
+	for (i = 0; i < 100 && !c.is_game_over; ++i)
+		play_move(&c, c.allowed_moves.moves[(i * 7) % c.allowed_moves.size]);
+	ASSERT_ERROR (mem_get_stats(MEM_GAME, &stats)->live_bytes < 4096, "Error: %llu bytes for a game of %u moves", stats.live_bytes, i);
+	free_chess(&c);
+	ASSERT_ERROR (mem_get_stats(MEM_GAME, &stats)->live_bytes == 0 && stats.live_allocations == 0, "Error: free_chess left %llu bytes", stats.live_bytes);
+
+	// level filters are checked before a message is formatted
+	ASSERT_ERROR (log_parse_levels("chess_test.c=warning,info") && !log_parse_levels("chess_test.c=verbose"), "Error: log levels not parsed");
+	ASSERT_ERROR (!log_enabled(&site, LOG_LEVEL_INFO) && log_enabled(&site, LOG_LEVEL_WARNING), "Error: module level not applied");
+	ASSERT_ERROR (log_parse_levels("*=error") && log_module_levels[0] == LOG_LEVEL_ERROR, "Error: level of module * not set");
+	log_parse_levels("debug,chess_test.c=debug,*=debug");
 	return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "epd.h"
+#include "log.h"
+#include "mem.h"
+#include "perft.h"
+#include "platform.h"
+#include "search.h"
+#include "tt.h"
+
+#define EPD_PERFT_MAX_DEPTH 15 /* deepest D operation looked for */
+
+typedef struct epd_suite epd_suite;
+
+typedef struct {
+	epd_suite *suite;
+	transposition_table tt; /* only allocated for EPD_BEST_MOVE */
+	platform_thread *thread;
+	char text[EPD_LINE_MAX];
+} epd_worker;
+
+/// state shared by the workers, everything but the options is guarded by lock
+struct epd_suite {
+	const epd_options *o;
+	FILE *file;
+	platform_mutex *lock;
+	u64 line; /* lines read so far */
+	epd_report report;
+	void *arg;
+	epd_summary *summary;
+};
+
+static void epd_worker_run(void *arg);
+static bool read_line(epd_suite *s, char *text, u64 *line);
+static void check_perft(const epd_options *o, chess_state *c, const char *operations, epd_result *r);
+static void check_best_move(const epd_options *o, transposition_table *tt, const chess_state *c, const char *operations, epd_result *r);
+static bool move_listed(const chess_state *c, const char *operands, move m, bool *valid);
+
+bool epd_run(const char *path, const epd_options *o, epd_report report, void *arg, epd_summary *summary)
+{
+	epd_suite suite = { o, NULL, NULL, 0, report, arg, summary };
+	epd_worker *workers;
+	u64 start = time_now_ns();
+	u32 i, started;
+
+	ASSERT_ERROR (path && o && summary, "Argument path, o or summary is NULL");
+	memset(summary, 0, sizeof (epd_summary));
+	if (!o->thread_num || (o->mode == EPD_BEST_MOVE && !o->depth && !o->time_limit_ns))
+		return false;
+	suite.file = fopen(path, "r");
+	if (!suite.file)
+		return false;
+	suite.lock = mutex_create();
+	ASSERT_ERROR (suite.lock, "mutex_create returned NULL!");
+
+	workers = mem_calloc(MEM_EPD, o->thread_num, sizeof (epd_worker));
+	ASSERT_ERROR (workers, "Could not allocate %u suite workers", o->thread_num);
+	for (i = 0; i < o->thread_num; ++i) {
+		workers[i].suite = &suite;
+		if (o->mode == EPD_BEST_MOVE && !tt_init(&workers[i].tt, o->hash_mb)) {
+			while (i--)
+				tt_free(&workers[i].tt);
+			mem_free(MEM_EPD, workers, o->thread_num * sizeof (epd_worker));
+			mutex_destroy(suite.lock);
+			fclose(suite.file);
+			return false;
+		}
+	}
+
+	// the calling thread works as worker 0, the remaining lines go to it if threads could not be started
+	for (started = 1; started < o->thread_num; ++started) {
+		workers[started].thread = thread_start(epd_worker_run, &workers[started]);
+		if (!workers[started].thread) {
+			LOG_WARNING ("Could only start %u of %u suite threads", started, o->thread_num);
+			break;
+		}
+	}
+	epd_worker_run(&workers[0]);
+	for (i = 1; i < started; ++i)
+		thread_join(workers[i].thread);
+
+	for (i = 0; i < o->thread_num; ++i) {
+		if (o->mode == EPD_BEST_MOVE)
+			tt_free(&workers[i].tt);
+	}
+	mem_free(MEM_EPD, workers, o->thread_num * sizeof (epd_worker));
+	mutex_destroy(suite.lock);
+	fclose(suite.file);
+	summary->time_ns = time_now_ns() - start;
+	return true;
+}
+
+bool epd_parse_position(chess_state *c, const char *line, const char **operations)
+{
+	char fen[EPD_LINE_MAX];
+	const char *p = line, *operands;
+	u32 field;
+
+	// four position fields, then up to two move counters as in FEN
+	for (; *p == ' ' || *p == '\t'; ++p);
+	for (field = 0; field < 6 && *p && *p != ';'; ++field) {
+		if (field >= 4 && (*p < '0' || *p > '9'))
+			break;
+		for (; *p && *p != ' ' && *p != '\t' && *p != ';'; ++p);
+		for (; *p == ' ' || *p == '\t'; ++p);
+	}
+	if (field < 4 || (size_t) (p - line) >= sizeof (fen))
+		return false;
+	memcpy(fen, line, (size_t) (p - line));
+	fen[p - line] = '\0';
+	if (!chess_state_from_fen(c, fen))
+		return false;
+
+	// the counters do not change the Zobrist key
+	if ((operands = epd_find_operation(p, "hmvc")) != NULL)
+		c->halfmove_clock = (u16) strtoul(operands, NULL, 10);
+	if ((operands = epd_find_operation(p, "fmvn")) != NULL && strtoul(operands, NULL, 10))
+		c->fullmove_number = (u16) strtoul(operands, NULL, 10);
+	*operations = p;
+	return true;
+}
+
+const char *epd_find_operation(const char *operations, const char *opcode)
+{
+	const char *p = operations, *start;
+	size_t length = strlen(opcode);
+	bool quoted;
+
+	while (*p) {
+		for (; *p == ' ' || *p == '\t' || *p == ';'; ++p);
+		start = p;
+		for (; *p && *p != ' ' && *p != '\t' && *p != ';'; ++p);
+		if ((size_t) (p - start) == length && !strncmp(start, opcode, length)) {
+			for (; *p == ' ' || *p == '\t'; ++p);
+			return p;
+		}
+		// skip the operands, string operands may contain ';'
+		for (quoted = false; *p && (quoted || *p != ';'); ++p) {
+			if (*p == '"')
+				quoted = !quoted;
+		}
+	}
+	return NULL;
+}
+
+static void epd_worker_run(void *arg)
+{
+	epd_worker *w = arg;
+	epd_suite *s = w->suite;
+	epd_result r;
+	chess_state c;
+	const char *operations;
+	u64 line, start;
+
+	while (read_line(s, w->text, &line)) {
+		memset(&r, 0, sizeof (r));
+		r.line = line;
+		r.text = w->text;
+		start = time_now_ns();
+		r.valid = w->text[0] != '\0' && epd_parse_position(&c, w->text, &operations);
+		if (r.valid && s->o->mode == EPD_PERFT)
+			check_perft(s->o, &c, operations, &r);
+		else if (r.valid)
+			check_best_move(s->o, &w->tt, &c, operations, &r);
+		r.passed &= r.valid;
+		r.time_ns = time_now_ns() - start;
+
+		mutex_lock(s->lock);
+		++s->summary->positions;
+		if (!r.valid)
+			++s->summary->invalid;
+		else if (r.passed)
+			++s->summary->passed;
+		else
+			++s->summary->failed;
+		s->summary->nodes += r.nodes;
+		if (s->report)
+			s->report(&r, s->arg);
+		mutex_unlock(s->lock);
+	}
+}
+
+// next line holding a position, an empty text marks a line that was too long
+static bool read_line(epd_suite *s, char *text, u64 *line)
+{
+	size_t length;
+	bool found = false;
+	int ch;
+
+	mutex_lock(s->lock);
+	while (!found && fgets(text, EPD_LINE_MAX, s->file)) {
+		*line = ++s->line;
+		length = strcspn(text, "\r\n");
+		if (!text[length] && !feof(s->file)) {
+			for (ch = fgetc(s->file); ch != EOF && ch != '\n'; ch = fgetc(s->file));
+			text[0] = '\0';
+			found = true;
+			break;
+		}
+		text[length] = '\0';
+		found = text[strspn(text, " \t")] != '\0' && text[0] != '#';
+	}
+	mutex_unlock(s->lock);
+	return found;
+}
+
+// counts every listed depth up to the limit, or the limit itself if the line lists none; without both the line is invalid
+static void check_perft(const epd_options *o, chess_state *c, const char *operations, epd_result *r)
+{
+	const char *operands;
+	char opcode[4];
+	char *end;
+	u32 depth, max_depth = o->depth ? o->depth : EPD_PERFT_MAX_DEPTH;
+
+	r->passed = true;
+	for (depth = 1; depth <= max_depth; ++depth) {
+		snprintf(opcode, sizeof (opcode), "D%u", depth);
+		operands = epd_find_operation(operations, opcode);
+		if (!operands)
+			continue;
+		r->expected = strtoull(operands, &end, 10);
+		if (end == operands) {
+			r->valid = false;
+			return;
+		}
+		r->depth = depth;
+		r->nodes = perft(c, depth);
+		r->passed &= r->nodes == r->expected;
+	}
+	if (!r->depth && o->depth) {
+		r->depth = o->depth;
+		r->nodes = perft(c, o->depth);
+	}
+	r->valid &= r->depth != 0;
+}
+
+static void check_best_move(const epd_options *o, transposition_table *tt, const chess_state *c, const char *operations, epd_result *r)
+{
+	search_limits limits = { o->depth, o->time_limit_ns, 0, NULL };
+	search_result result;
+	const char *best = epd_find_operation(operations, "bm");
+	const char *avoid = epd_find_operation(operations, "am");
+
+	tt_clear(tt);
+	search(c, NULL, tt, &limits, &result);
+	r->depth = result.depth;
+	r->nodes = result.nodes;
+	r->best_move = result.best_move;
+	r->passed = true;
+	if (best)
+		r->passed &= move_listed(c, best, result.best_move, &r->valid);
+	if (avoid)
+		r->passed &= !move_listed(c, avoid, result.best_move, &r->valid);
+}
+
+// checks if m is among the moves of a bm or am operation, valid is cleared if one cannot be parsed
+static bool move_listed(const chess_state *c, const char *operands, move m, bool *valid)
+{
+	move listed;
+	bool found = false;
+	u32 i;
+
+	for (i = 0; i < EPD_MAX_MOVES; ++i) {
+		for (; *operands == ' ' || *operands == '\t'; ++operands);
+		if (!*operands || *operands == ';')
+			break;
+		if (!parse_move(c, operands, &listed, &operands)) {
+			*valid = false;
+			return false;
+		}
+		found |= listed == m;
+	}
+	return found;
+}
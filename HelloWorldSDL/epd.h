@@ -0,0 +1,91 @@
+#ifndef EPD_H
+#define EPD_H
+
+#include "chess.h"
+#include "types.h"
+
+#define EPD_LINE_MAX 1024 /* longer lines are reported as invalid */
+#define EPD_MAX_MOVES 8 /* moves listed by one bm or am operation */
+
+typedef enum {
+	EPD_PERFT, /* count the leaf nodes for every "D<depth> <nodes>" operation */
+	EPD_BEST_MOVE /* search and compare with the "bm" and "am" operations */
+} epd_mode;
+
+/// <summary>
+/// What to check for each position of a suite
+/// </summary>
+typedef struct {
+	epd_mode mode;
+	u32 thread_num; /* workers including the calling thread, each works on one position at a time */
+	u32 depth; /* perft: deepest D operation checked, 0 for all; search: depth limit, 0 for none */
+	u64 time_limit_ns; /* search time per position, 0 for no limit */
+	u64 hash_mb; /* transposition table size of each worker for EPD_BEST_MOVE */
+} epd_options;
+
+/// <summary>
+/// Outcome of one line of a suite
+/// </summary>
+typedef struct {
+	u64 line; /* line number in the file, starting at 1 */
+	const char *text; /* the line without line break */
+	bool valid; /* false if the position or an operation could not be parsed, or a perft line had no depth to count */
+	bool passed; /* every checked perft count matched, or the best move was expected and not avoided */
+	u32 depth; /* deepest perft depth counted or last completed search iteration */
+	u64 nodes; /* leaf nodes counted at depth or nodes searched */
+	u64 expected; /* nodes expected at depth, 0 if the line lists none */
+	move best_move; /* best move found by the search */
+	u64 time_ns; /* time spent on the position */
+} epd_result;
+
+/// <summary>
+/// Called for every position once it is done, in the order the positions finish.
+/// Calls are serialized, so the callback needs no locking of its own.
+/// </summary>
+typedef void (*epd_report)(const epd_result *r, void *arg);
+
+/// <summary>
+/// Totals of a suite run
+/// </summary>
+typedef struct {
+	u64 positions; /* lines holding a position, including invalid ones */
+	u64 passed;
+	u64 failed;
+	u64 invalid;
+	u64 nodes; /* summed over all positions */
+	u64 time_ns; /* wall clock time of the whole run */
+} epd_summary;
+
+/// <summary>
+/// Run a suite in Extended Position Description format, one position per line followed by its operations,
+/// e.g. "4k3/8/8/8/8/8/8/4K2R w K - bm Rh8+;" or "4k3/8/8/8/8/8/8/4K2R w K - 0 1 ;D1 15 ;D2 66".
+/// The file is read line by line while the workers take the positions, so suites of any size can be run.
+/// Empty lines and lines starting with '#' are skipped.
+/// </summary>
+/// <param name="path">suite file</param>
+/// <param name="o">what to check</param>
+/// <param name="report">called for each position, may be NULL</param>
+/// <param name="arg">passed to report</param>
+/// <param name="summary">receives the totals</param>
+/// <returns>false if the file could not be opened or a transposition table not allocated</returns>
+bool epd_run(const char *path, const epd_options *o, epd_report report, void *arg, epd_summary *summary);
+
+/// <summary>
+/// Parse the position at the start of an EPD line. The halfmove clock and fullmove number may follow the
+/// four position fields like in FEN, or be given by "hmvc" and "fmvn" operations.
+/// </summary>
+/// <param name="c">receives the position</param>
+/// <param name="line">EPD line</param>
+/// <param name="operations">receives the start of the operations</param>
+/// <returns>false if the position could not be parsed</returns>
+bool epd_parse_position(chess_state *c, const char *line, const char **operations);
+
+/// <summary>
+/// Find an operation of an EPD line
+/// </summary>
+/// <param name="operations">operations as returned by epd_parse_position</param>
+/// <param name="opcode">e.g. "bm" or "D5"</param>
+/// <returns>start of its operands, ending at the next ';', or NULL if the line has no such operation</returns>
+const char *epd_find_operation(const char *operations, const char *opcode);
+
+#endif
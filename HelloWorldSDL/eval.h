@@ -0,0 +1,19 @@
+#ifndef EVAL_H
+#define EVAL_H
+
+#include "chess.h"
+#include "types.h"
+
+/// <summary>
+/// Material value of each piece type in centipawns, the king is worth nothing
+/// </summary>
+extern const i32 piece_values[PIECE_TYPE_MAX];
+
+/// <summary>
+/// Static evaluation: material plus a bonus per piece for its square
+/// </summary>
+/// <param name="c">game state</param>
+/// <returns>score in centipawns from the view of the active color</returns>
+i32 evaluate(const chess_state *c);
+
+#endif
@@ -1,82 +1,369 @@
+#if !defined _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <stdbool.h>
 #include <stdlib.h>
-#include <inttypes.h>
 #include <stdio.h>
-#include <windows.h>
+#include <string.h>
+#include <time.h>
 
 #include "log.h"
+#include "platform.h"
 #include "types.h"
 
-// TODO fix logging system: vprintf is sometimes stuck, no backup of previous log files.
+#define MODULE_NAME_MAX 32
+
+typedef enum {
+	LOG_STOPPED, /* nothing logged yet */
+	LOG_STARTING, /* first message is setting up the writer */
+	LOG_RUNNING, /* messages go through the queue */
+	LOG_STOPPING, /* writer empties the queue and exits */
+	LOG_DIRECT /* writer stopped or could not be started, messages are written by the caller */
+} log_state;
+
+/// <summary>
+/// Queue slot. A producer takes ticket t from queue_tail and owns slot t % LOG_QUEUE_SIZE
+/// once its sequence is t. It publishes the message by setting the sequence to t + 1, and
+/// the writer frees the slot for ticket t + LOG_QUEUE_SIZE after writing it.
+/// </summary>
+typedef struct {
+	volatile u32 sequence;
+	log_level level;
+	const char *module; /* file name of the site */
+	const char *func;
+	long line;
+	struct timespec time; /* wall clock time of the call */
+	char message[LOG_MESSAGE_MAX];
+} log_record;
+
+volatile u8 log_module_levels[LOG_MODULE_MAX];
+
+#ifndef RELEASE
+static log_record queue[LOG_QUEUE_SIZE];
+#endif
+static volatile u64 queue_tail; /* tickets handed out */
+static volatile u64 queue_head; /* records written, only changed by the writer */
+static volatile u64 queue_flushed; /* records written and flushed to the file */
+static volatile u32 state = LOG_STOPPED;
+static platform_thread *writer;
+static platform_event *writer_wakeup; /* signaled after publishing a record, kept until the process exits */
+
+static FILE *log_file; /* NULL if LOG_FILE could not be opened */
+#ifndef RELEASE
+static u64 log_file_bytes;
+#endif
 
-static FILE* log_file;
+// module 0 collects the files which did not fit into the table
+static char module_names[LOG_MODULE_MAX][MODULE_NAME_MAX] = { "*" };
+static bool module_has_level[LOG_MODULE_MAX];
+static u32 module_num = 1;
+static volatile u32 module_lock;
+static log_level default_level = LOG_LEVEL_DEBUG;
 
-static bool create_log_file(void)
+#ifndef RELEASE
+static const char *level_strings[LOG_LEVEL_NONE + 1] = { "DEBUG  ", "INFO   ", "WARNING", "ERROR  ", "NONE   " };
+#endif
+static const char *level_names[LOG_LEVEL_NONE + 1] = { "debug", "info", "warning", "error", "none" };
+
+#ifndef RELEASE
+static void start(void);
+static void write_loop(void *arg);
+static void write_record(const log_record *r);
+static void rotate_log_file(void);
+#endif
+static u32 find_module(const char *name);
+static const char *file_name(const char *path);
+
+u32 log_register_site(log_site *site)
 {
-	u32 i;
-	char* log_file_name = malloc(sizeof(LOG_FILE) + (sizeof (u32) * 2));
-	if (!log_file_name) {
-		printf("ERROR: Could not set up log file\n");
-		goto EXIT_ERROR;
-	}
+	u32 module = find_module(file_name(site->file)) + 1;
 
-	sprintf(log_file_name, LOG_FILE);
-
-	i = 0;
-	// check if log file exists. If yes, move it
-	// TODO moving file does not work, always overrides log file instead
-	printf("Checking if file %s exists...", log_file_name);
-	// TODO fixme
-	//if (0xFFFFFFFF == GetFileAttributesA(log_file_name)) {
-
-	//	while (!GetFileAttributesA(log_file_name)) {
-	//		printf("... File %s exists!\n", log_file_name);
-	//		sprintf(log_file_name, "%s%" PRIu32 "X", LOG_FILE, i);
-	//		i++;
-	//	}
-	//	printf("... File %s does not exists!\n", log_file_name);
-	//	sprintf(log_file_name, "%s%" PRIu32 "X", LOG_FILE, i);
-
-	//	if (!rename(LOG_FILE, log_file_name)) {
-	//		printf("ERROR: Could not move log file!\n");
-	//		goto EXIT_ERROR_CLEANUP;
-	//	}
-	//}
-
-	//log_file = fopen(log_file_name, "w");
-	//free(log_file_name);
-	return 1;
-
-EXIT_ERROR_CLEANUP:
-	free(log_file_name);
-EXIT_ERROR:
-	return 0;
+	// racing first calls of a site store the same value
+	atomic_store_u32(&site->module, module);
+	return module;
 }
 
 void log_this(
-	const char* severity,
-	const char* time,
-	const char* file,
-	const char* func,
+	log_site *site,
+	log_level level,
+	const char *func,
 	long line,
-	const char* fmt, ...)
+	const char *fmt, ...)
 {
 #ifndef RELEASE
 	va_list args;
+	log_record *r, direct;
+	u64 ticket;
+
+	if (atomic_load_u32(&state) != LOG_RUNNING)
+		start();
 
+	if (atomic_load_u32(&state) == LOG_RUNNING) {
+		ticket = atomic_add_u64(&queue_tail, 1) - 1;
+		r = &queue[ticket & (LOG_QUEUE_SIZE - 1)];
+		// the queue is full, wait for the writer
+		while (atomic_load_u32(&r->sequence) != (u32) ticket)
+			thread_sleep_ms(0);
+	} else {
+		r = &direct;
+	}
+
+	r->level = level;
+	r->module = module_names[site->module - 1];
+	r->func = func;
+	r->line = line;
+	timespec_get(&r->time, TIME_UTC);
 	va_start(args, fmt);
+	vsnprintf(r->message, LOG_MESSAGE_MAX, fmt, args);
+	va_end(args);
 
-	if (!log_file) {
-			create_log_file();
+	if (r == &direct) {
+		write_record(r);
+		fflush(stdout);
+		return;
 	}
+	atomic_store_u32(&r->sequence, (u32) ticket + 1);
+	event_signal(writer_wakeup);
+	if (level >= LOG_LEVEL_ERROR)
+		log_flush();
+#else
+	(void) site;
+	(void) level;
+	(void) func;
+	(void) line;
+	(void) fmt;
+#endif
+}
+
+bool log_set_level(const char *module, log_level level)
+{
+	u32 i;
+
+	if (module) {
+		// find_module never returns module 0, only if the table is full
+		if (!strcmp(module, "*"))
+			i = 0;
+		else if (!(i = find_module(module)))
+			return false;
+		module_has_level[i] = true;
+		log_module_levels[i] = (u8) level;
+		return true;
+	}
+
+	default_level = level;
+	for (i = 0; i < LOG_MODULE_MAX; ++i) {
+		if (!module_has_level[i])
+			log_module_levels[i] = (u8) level;
+	}
+	return true;
+}
+
+bool log_parse_levels(const char *levels)
+{
+	char module[MODULE_NAME_MAX];
+	const char *end, *equals, *name;
+	log_level level;
+	size_t length;
+
+	while (*levels) {
+		end = strchr(levels, ',');
+		if (!end)
+			end = levels + strlen(levels);
+		equals = memchr(levels, '=', (size_t) (end - levels));
+
+		name = equals ? equals + 1 : levels;
+		length = (size_t) (end - name);
+		for (level = 0; level <= LOG_LEVEL_NONE; ++level) {
+			if (strlen(level_names[level]) == length && !strncmp(level_names[level], name, length))
+				break;
+		}
+		if (level > LOG_LEVEL_NONE)
+			return false;
+
+		if (equals) {
+			if ((size_t) (equals - levels) >= MODULE_NAME_MAX || equals == levels)
+				return false;
+			memcpy(module, levels, (size_t) (equals - levels));
+			module[equals - levels] = '\0';
+			if (!log_set_level(module, level))
+				return false;
+		} else {
+			log_set_level(NULL, level);
+		}
+		levels = *end ? end + 1 : end;
+	}
+	return true;
+}
+
+void log_flush(void)
+{
+	u64 target = atomic_add_u64(&queue_tail, 0);
+
+	if (atomic_load_u32(&state) == LOG_RUNNING) {
+		event_signal(writer_wakeup);
+		while (atomic_add_u64(&queue_flushed, 0) < target)
+			thread_sleep_ms(1);
+	}
+	fflush(stdout);
+}
+
+void log_shutdown(void)
+{
+	if (!atomic_cas_u32(&state, LOG_RUNNING, LOG_STOPPING))
+		return;
+	// producers which took a ticket before may still signal writer_wakeup, so it is not destroyed
+	event_signal(writer_wakeup);
+	thread_join(writer);
+	writer = NULL;
+	if (log_file)
+		fclose(log_file);
+	log_file = NULL;
+	atomic_store_u32(&state, LOG_DIRECT);
+}
+
+#ifndef RELEASE
+// the first message starts the writer, concurrent ones wait for it
+static void start(void)
+{
+	u32 i;
+
+	if (!atomic_cas_u32(&state, LOG_STOPPED, LOG_STARTING)) {
+		while (atomic_load_u32(&state) == LOG_STARTING)
+			thread_sleep_ms(0);
+		return;
+	}
+
+	for (i = 0; i < LOG_QUEUE_SIZE; ++i)
+		queue[i].sequence = i;
+	rotate_log_file();
+	writer_wakeup = event_create();
+	writer = writer_wakeup ? thread_start(write_loop, NULL) : NULL;
+	if (!writer) {
+		atomic_store_u32(&state, LOG_DIRECT);
+		return;
+	}
+	atexit(log_shutdown);
+	atomic_store_u32(&state, LOG_RUNNING);
+}
+
+static void write_loop(void *arg)
+{
+	u64 head = 0, flushed = 0;
+	log_record *r;
+
+	(void) arg;
+	for (;;) {
+		r = &queue[head & (LOG_QUEUE_SIZE - 1)];
+		if (atomic_load_u32(&r->sequence) != (u32) head + 1) {
+			// idle, make everything written so far visible before waiting
+			if (flushed != head) {
+				fflush(stdout);
+				if (log_file)
+					fflush(log_file);
+				atomic_add_u64(&queue_flushed, head - flushed);
+				flushed = head;
+			}
+			if (atomic_load_u32(&state) == LOG_STOPPING && head == atomic_add_u64(&queue_tail, 0))
+				break;
+			// the record may have been published after the check above, then the event is already signaled
+			event_wait(writer_wakeup);
+			continue;
+		}
+
+		write_record(r);
+		atomic_store_u32(&r->sequence, (u32) (head + LOG_QUEUE_SIZE));
+		head = atomic_add_u64(&queue_head, 1);
+		if (log_file_bytes > LOG_FILE_MAX_BYTES)
+			rotate_log_file();
+	}
+}
+
+static void write_record(const log_record *r)
+{
+	time_t seconds = r->time.tv_sec;
+	struct tm local, *t = &local;
+	int n;
+
+	// the caller and the writer may format records at the same time, localtime() shares its result
+#if defined _WIN32
+	localtime_s(t, &seconds);
+#else
+	localtime_r(&seconds, t);
+#endif
+
+	printf("%02d:%02d:%02d.%03ld %s %s %s():% 4ld: %s\n", t->tm_hour, t->tm_min, t->tm_sec, r->time.tv_nsec / 1000000,
+		level_strings[r->level], r->module, r->func, r->line, r->message);
 	if (log_file) {
-		fprintf(log_file, "%s %s %s %s():% 4ld: ", time, severity, file, func, line);
-		vfprintf(log_file, fmt, args);
-		fprintf(log_file, "\n");
+		n = fprintf(log_file, "%02d:%02d:%02d.%03ld %s %s %s():% 4ld: %s\n", t->tm_hour, t->tm_min, t->tm_sec, r->time.tv_nsec / 1000000,
+			level_strings[r->level], r->module, r->func, r->line, r->message);
+		if (n > 0)
+			log_file_bytes += (u64) n;
 	}
-	printf("%s %s %s %s():% 4ld: ", time, severity, file, func, line);
-	vprintf(fmt, args);
-	printf("\n");
-	va_end(args);
+}
+
+// LOG_FILE becomes LOG_FILE.1, LOG_FILE.1 becomes LOG_FILE.2 and so on, the oldest one is deleted
+static void rotate_log_file(void)
+{
+	char from[sizeof (LOG_FILE) + 8], to[sizeof (LOG_FILE) + 8];
+	i32 i;
+
+	if (log_file)
+		fclose(log_file);
+	log_file = NULL;
+	log_file_bytes = 0;
+
+	if (!create_directory(LOG_DIRECTORY)) {
+		printf("Could not create log directory %s\n", LOG_DIRECTORY);
+		return;
+	}
+	snprintf(to, sizeof (to), "%s.%d", LOG_FILE, LOG_FILE_BACKUPS);
+	remove(to);
+	for (i = LOG_FILE_BACKUPS - 1; i >= 0; --i) {
+		if (i)
+			snprintf(from, sizeof (from), "%s.%d", LOG_FILE, i);
+		else
+			snprintf(from, sizeof (from), "%s", LOG_FILE);
+		snprintf(to, sizeof (to), "%s.%d", LOG_FILE, i + 1);
+		rename(from, to);
+	}
+
+	log_file = fopen(LOG_FILE, "w");
+	if (!log_file)
+		printf("Could not open log file %s\n", LOG_FILE);
+}
 #endif
-}
\ No newline at end of file
+
+// index of a module, added with the default level if it is new
+static u32 find_module(const char *name)
+{
+	u32 i;
+
+	while (!atomic_cas_u32(&module_lock, 0, 1))
+		thread_sleep_ms(0);
+
+	for (i = 1; i < module_num && strncmp(module_names[i], name, MODULE_NAME_MAX - 1); ++i);
+	if (i == module_num) {
+		if (module_num == LOG_MODULE_MAX) {
+			i = 0;
+		} else {
+			snprintf(module_names[i], MODULE_NAME_MAX, "%s", name);
+			log_module_levels[i] = (u8) default_level;
+			++module_num;
+		}
+	}
+
+	atomic_store_u32(&module_lock, 0);
+	return i;
+}
+
+static const char *file_name(const char *path)
+{
+	const char *name = path;
+
+	for (; *path; ++path) {
+		if (*path == '/' || *path == '\\')
+			name = path + 1;
+	}
+	return name;
+}
@@ -2,72 +2,157 @@
 #define LOG_H
 
 #include <stdarg.h>
+#include <stdlib.h>
+
+#include "types.h"
+
+#ifndef LOG_DIRECTORY
+#define LOG_DIRECTORY "./logs"
+#endif // LOG_DIRECTORY
 
 #ifndef LOG_FILE
-#define LOG_FILE "./logs/log"
+#define LOG_FILE LOG_DIRECTORY "/log"
 #endif // LOG_FILE
 
-#define LOG_WARNING(fmt, ...) \
+#define LOG_FILE_MAX_BYTES (16 * 1024 * 1024) /* the log file is rotated when it grows beyond this */
+#define LOG_FILE_BACKUPS 4 /* LOG_FILE.1 is the newest rotated file, LOG_FILE.4 the oldest one kept */
+#define LOG_QUEUE_SIZE 1024 /* messages waiting for the writer thread, power of two */
+#define LOG_MESSAGE_MAX 256 /* longer messages are truncated */
+#define LOG_MODULE_MAX 32 /* source files with their own level, further ones share the level of module "*" */
+
+typedef enum {
+	LOG_LEVEL_DEBUG,
+	LOG_LEVEL_INFO,
+	LOG_LEVEL_WARNING,
+	LOG_LEVEL_ERROR,
+	LOG_LEVEL_NONE /* filters everything */
+} log_level;
+
+/// <summary>
+/// Place in the source which logs. Every log macro has its own static site, which
+/// remembers the module of its source file so the level check is a single table lookup.
+/// </summary>
+typedef struct {
+	const char *file; /* __FILE__ of the site */
+	volatile u32 module; /* index into log_module_levels + 1, 0 before the first message */
+} log_site;
+
+/* minimum level per module, written by log_set_level. Readers may see a changed level a little late. */
+extern volatile u8 log_module_levels[LOG_MODULE_MAX];
+
+#define LOG_AT(level, ...) \
 	do { \
-		log_this("WARNING", __TIME__, __FILE__, __func__, __LINE__, fmt, __VA_ARGS__); \
+		static log_site log_site_ = { __FILE__, 0 }; \
+		if (log_enabled(&log_site_, level)) \
+			log_this(&log_site_, level, __func__, __LINE__, __VA_ARGS__); \
 	} while(0)
 
-#define ASSERT_WARNING(cond, fmt, ...) \
+#define LOG_WARNING(...) \
 	do { \
-		if (!(cond)) log_this("WARNING", __TIME__, __FILE__, __func__, __LINE__, fmt, __VA_ARGS__); \
+		LOG_AT(LOG_LEVEL_WARNING, __VA_ARGS__); \
+	} while(0)
+
+#define ASSERT_WARNING(cond, ...) \
+	do { \
+		if (!(cond)) LOG_AT(LOG_LEVEL_WARNING, __VA_ARGS__); \
 	} while(0)
 
 #if defined DEBUG || defined _DEBUG
-#define LOG_DEBUG(fmt, ...) \
+#define LOG_DEBUG(...) \
 	do { \
-		log_this("DEBUG  ", __TIME__, __FILE__, __func__, __LINE__, fmt, __VA_ARGS__); \
+		LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__); \
 	} while(0)
 
-#define ASSERT_DEBUG(cond, fmt, ...) \
+#define ASSERT_DEBUG(cond, ...) \
 	do { \
-		if (!(cond)) log_this("DEBUG  ", __TIME__, __FILE__, __func__, __LINE__, fmt, __VA_ARGS__); \
+		if (!(cond)) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__); \
 	} while(0)
 #else
-#define LOG_DEBUG(fmt, ...) \
+#define LOG_DEBUG(...) \
 	do { \
 	} while(0)
 
-#define ASSERT_DEBUG(fmt, ...) \
+#define ASSERT_DEBUG(cond, ...) \
 	do { \
 	} while(0)
 #endif // defined DEBUG || defined _DEBUG
 
-#define LOG_INFO(fmt, ...) \
+#define LOG_INFO(...) \
 	do { \
-		log_this("INFO   ", __TIME__, __FILE__, __func__, __LINE__, fmt, __VA_ARGS__); \
+		LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__); \
 	} while(0)
 
-#define ASSERT_INFO(cond, fmt, ...) \
+#define ASSERT_INFO(cond, ...) \
 	do { \
-		if (!(cond)) log_this("INFO   ", __TIME__, __FILE__, __func__, __LINE__, fmt, __VA_ARGS__); \
+		if (!(cond)) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__); \
 	} while(0)
 
-#define LOG_ERROR(fmt, ...) \
+#define LOG_ERROR(...) \
 	do { \
-		log_this("ERROR  ", __TIME__, __FILE__, __func__, __LINE__, fmt, __VA_ARGS__); \
+		LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__); \
 		exit(EXIT_FAILURE); \
 	} while(0)
 
-#define ASSERT_ERROR(cond, fmt, ...) \
+#define ASSERT_ERROR(cond, ...) \
 	do { \
 		if (!(cond)) {\
-			log_this("ERROR  ", __TIME__, __FILE__, __func__, __LINE__, fmt, __VA_ARGS__); \
+			LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__); \
 			exit(EXIT_FAILURE); \
 		} \
 	} while(0)
 
+/// <summary>
+/// Look up the module of a site the first time it logs
+/// </summary>
+/// <returns>site->module</returns>
+u32 log_register_site(log_site *site);
+
+/// <summary>
+/// Check if a message of a site would be written, before any arguments are formatted
+/// </summary>
+static inline bool log_enabled(log_site *site, log_level level)
+{
+	u32 module = site->module;
 
+	if (!module)
+		module = log_register_site(site);
+	return level >= (log_level) log_module_levels[module - 1];
+}
+
+/// <summary>
+/// Format a message and queue it for the writer thread, which prints it and appends it to LOG_FILE.
+/// Errors are written before this returns, as the program exits after them.
+/// </summary>
 void log_this(
-	const char *severity,
-	const char *time,
-	const char *file,
+	log_site *site,
+	log_level level,
 	const char *func,
 	long line,
 	const char *fmt, ...);
 
-#endif
\ No newline at end of file
+/// <summary>
+/// Set the minimum level of messages from a source file
+/// </summary>
+/// <param name="module">file name without directory, e.g. "search.c", or NULL for all modules without a level of their own</param>
+/// <param name="level">least severe level still written</param>
+/// <returns>false if there are too many modules already</returns>
+bool log_set_level(const char *module, log_level level);
+
+/// <summary>
+/// Set levels from a comma separated list of module=level pairs, a level without module sets the default.
+/// Levels are debug, info, warning, error and none, e.g. "warning,search.c=debug".
+/// </summary>
+/// <returns>false if the list could not be parsed completely</returns>
+bool log_parse_levels(const char *levels);
+
+/// <summary>
+/// Wait until all messages logged so far are written
+/// </summary>
+void log_flush(void);
+
+/// <summary>
+/// Write the remaining messages and stop the writer thread. Runs at exit, later messages are written directly.
+/// </summary>
+void log_shutdown(void);
+
+#endif
@@ -1,15 +1,26 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "SDL.h"
 #include "SDL_image.h"
+#include "bitbase.h"
+#include "book.h"
 #include "chess.h"
 #include "log.h"
+#include "mem.h"
+#include "platform.h"
+#include "profile.h"
+#include "search.h"
+#include "tt.h"
 #include "utils.h"
 
+#define WINDOW_WIDTH 512
+#define WINDOW_HEIGHT 700
 #define TEXTURE_SIZE 64
 #define BOARD_SIZE ((BOARD_SIDE_LENGTH) * TEXTURE_SIZE)
-#define BOARD_VERTICAL_OFFSET ((700 - BOARD_SIZE) / 2)
+#define BOARD_VERTICAL_OFFSET ((WINDOW_HEIGHT - BOARD_SIZE) / 2)
+#define SQUARE_HIGHLIGHT 0x80 /* flag of square_look, the low bits are the piece */
 
 typedef struct {
 	SDL_Texture *t;
@@ -24,8 +35,23 @@ SDL_Renderer *renderer;
 piece_texture piece_textures[COLOR_MAX][PIECE_TYPE_MAX];
 SDL_Texture *board_texture;
 SDL_Texture *highlight_texture;
+SDL_Texture *frame_texture; /* keeps the last frame, so only changed squares are drawn. NULL without render target support */
+int board_texture_w, board_texture_h;
+u8 square_look[SQUARE_NUM]; /* piece and highlight drawn on each square of frame_texture */
+bool is_frame_valid; /* false if frame_texture has to be drawn completely */
 pos active_field, move_input;
 bool is_active_field, is_move_input;
+bool use_vsync;
+platform_thread *computer_thread; /* searches the computer's move, NULL while no search runs */
+search_result computer_result; /* written by computer_thread */
+volatile u32 stop_computer; /* set to end the search of computer_thread early */
+Uint32 computer_done_event = (Uint32) -1; /* pushed when computer_thread is done, -1 if it could not be registered */
+bool is_computer_player[COLOR_MAX] = { false, true };
+u64 computer_time_ms = 1000;
+u64 hash_size_mb = TT_DEFAULT_SIZE_MB;
+u32 search_threads; /* 0 uses every processor */
+transposition_table tt;
+opening_book book; /* not mapped if data is NULL */
 
 #define STRING_MAX 256
 
@@ -48,7 +74,8 @@ void init_game(chess *c)
 	SDL_Surface *surface;
 	char path[256];
 	ASSERT_ERROR (!SDL_Init(SDL_INIT_EVERYTHING), "SDL_Init failed: %s", SDL_GetError());
-	ASSERT_ERROR (!SDL_CreateWindowAndRenderer(512, 700, 0, &window, &renderer), "SDL_Init failed: %s", SDL_GetError());
+	SDL_SetHint(SDL_HINT_RENDER_VSYNC, use_vsync ? "1" : "0");
+	ASSERT_ERROR (!SDL_CreateWindowAndRenderer(WINDOW_WIDTH, WINDOW_HEIGHT, 0, &window, &renderer), "SDL_Init failed: %s", SDL_GetError());
 	init_chess(c);
 
 	for (player = 0; player < COLOR_MAX; ++player) {
@@ -74,95 +101,269 @@ void init_game(chess *c)
 
 	board_texture = SDL_CreateTextureFromSurface(renderer, surface);
 	SDL_FreeSurface(surface);
+	SDL_QueryTexture(board_texture, NULL, NULL, &board_texture_w, &board_texture_h);
 	surface = IMG_Load("Sprites/highlight_square.png");
 	highlight_texture = SDL_CreateTextureFromSurface(renderer, surface);
 	SDL_FreeSurface(surface);
 
+	computer_done_event = SDL_RegisterEvents(1);
+	ASSERT_WARNING (computer_done_event != (Uint32) -1, "Could not register an event, the window will not respond while the computer thinks");
+
+	if (SDL_RenderTargetSupported(renderer))
+		frame_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, WINDOW_WIDTH, WINDOW_HEIGHT);
+	ASSERT_WARNING (frame_texture, "Could not create the frame texture, drawing every frame completely: %s", SDL_GetError());
+	is_frame_valid = false;
+
 	SDL_SetRenderDrawColor(renderer, 81, 42, 42, 255);
 }
 
-void show_move_option(const move *m)
+// what a square shows, 0 for an empty square without highlight
+void look_at_squares(const chess *c, u8 *looks)
+{
+	piece_color color;
+	piece_type t;
+	bitboard pieces;
+	move_list moves;
+	u32 i;
+
+	memset(looks, 0, SQUARE_NUM);
+	for (color = 0; color < COLOR_MAX; ++color) {
+		for (t = 0; t < PIECE_TYPE_MAX; ++t) {
+			pieces = c->current_state.pieces[color][t];
+			while (pieces)
+				looks[bb_pop_lsb(&pieces)] = (u8) (color * PIECE_TYPE_MAX + t + 1);
+		}
+	}
+
+	if (is_active_field && c->current_state.occupied_all & SQUARE_BB(SQUARE(active_field.x, active_field.y))) {
+		looks[SQUARE(active_field.x, active_field.y)] |= SQUARE_HIGHLIGHT;
+		valid_moves_from(c, active_field, &moves);
+		for (i = 0; i < moves.size; ++i)
+			looks[move_to(moves.moves[i])] |= SQUARE_HIGHLIGHT;
+	} else {
+		is_active_field = false;
+	}
+}
+
+void show_square(u32 square, u8 look)
 {
-	SDL_Rect r;
-	board_index_to_screen_pos(m->to.x, m->to.y, &r.x, &r.y);
+	piece_color color;
+	piece_type t;
+	SDL_Rect r, board;
+
+	board_index_to_screen_pos(SQUARE_X(square), SQUARE_Y(square), &r.x, &r.y);
 	r.w = TEXTURE_SIZE;
 	r.h = TEXTURE_SIZE;
-	ASSERT_ERROR (!SDL_RenderCopy(renderer, highlight_texture, NULL, &r), "SDL_RendererCopy failed: %s", SDL_GetError());
+	// the board texture covers the whole window
+	board.x = r.x * board_texture_w / WINDOW_WIDTH;
+	board.y = r.y * board_texture_h / WINDOW_HEIGHT;
+	board.w = (r.x + r.w) * board_texture_w / WINDOW_WIDTH - board.x;
+	board.h = (r.y + r.h) * board_texture_h / WINDOW_HEIGHT - board.y;
+	ASSERT_ERROR (!SDL_RenderCopy(renderer, board_texture, &board, &r), "SDL_RendererCopy failed: %s", SDL_GetError());
+
+	if (look & ~SQUARE_HIGHLIGHT) {
+		color = (piece_color) (((look & ~SQUARE_HIGHLIGHT) - 1) / PIECE_TYPE_MAX);
+		t = (piece_type) (((look & ~SQUARE_HIGHLIGHT) - 1) % PIECE_TYPE_MAX);
+		r.w = piece_textures[color][t].w / 4;
+		r.h = piece_textures[color][t].h / 4;
+		r.x += (TEXTURE_SIZE / 2) - piece_textures[color][t].x_center_offset / 4;
+		r.y += (TEXTURE_SIZE / 2) - piece_textures[color][t].y_center_offset / 4;
+		ASSERT_ERROR (!SDL_RenderCopy(renderer, piece_textures[color][t].t, NULL, &r), "SDL_RendererCopy failed: %s", SDL_GetError());
+	}
+
+	if (look & SQUARE_HIGHLIGHT) {
+		board_index_to_screen_pos(SQUARE_X(square), SQUARE_Y(square), &r.x, &r.y);
+		r.w = TEXTURE_SIZE;
+		r.h = TEXTURE_SIZE;
+		ASSERT_ERROR (!SDL_RenderCopy(renderer, highlight_texture, NULL, &r), "SDL_RendererCopy failed: %s", SDL_GetError());
+	}
 }
 
+// draws the squares which changed since the last frame into frame_texture and presents nothing if none did
 void show_game(const chess *c)
 {
-	u8 x, y;
-	SDL_Rect r;
-	const piece *p;
+	u8 looks[SQUARE_NUM];
+	u32 square;
+	bool is_changed = !is_frame_valid;
+
+	look_at_squares(c, looks);
+	if (frame_texture)
+		SDL_SetRenderTarget(renderer, frame_texture);
+	if (!is_frame_valid) {
+		SDL_RenderClear(renderer);
+		ASSERT_ERROR (!SDL_RenderCopy(renderer, board_texture, NULL, NULL), "SDL_RendererCopy failed: %s", SDL_GetError());
+	}
+	for (square = 0; square < SQUARE_NUM; ++square) {
+		if (is_frame_valid && looks[square] == square_look[square])
+			continue;
+		show_square(square, looks[square]);
+		square_look[square] = looks[square];
+		is_changed = true;
+	}
+	if (!is_changed)
+		return;
 
-	SDL_RenderClear(renderer);
+	// without a render target the back buffer is lost after presenting, so every frame is drawn completely
+	if (frame_texture) {
+		SDL_SetRenderTarget(renderer, NULL);
+		ASSERT_ERROR (!SDL_RenderCopy(renderer, frame_texture, NULL, NULL), "SDL_RendererCopy failed: %s", SDL_GetError());
+	}
+	is_frame_valid = frame_texture != NULL;
+	SDL_RenderPresent(renderer);
+}
 
-	r.x = 0;
-	r.y = 0;
-	ASSERT_ERROR (!SDL_RenderCopy(renderer, board_texture, NULL, NULL), "SDL_RendererCopy failed: %s", SDL_GetError());
+void search_computer_move(const chess *c)
+{
+	search_limits limits = { 0, computer_time_ms * 1000000, 0, &stop_computer };
 
+	search_parallel(&c->current_state, &c->positions, &tt, &limits, search_threads ? search_threads : cpu_count(), &computer_result);
+}
 
-	for (x = 0; x < BOARD_SIDE_LENGTH; ++x) {
-		for (y = 0; y < BOARD_SIDE_LENGTH; ++y) {
-			p = &c->current_state.board[y][x];
-			if (!p->is_piece)
-				continue;
+// runs on computer_thread, the event loop leaves the game unchanged until computer_done_event arrives
+void computer_thread_run(void *arg)
+{
+	SDL_Event e;
 
-			r.w = piece_textures[p->c][p->t].w / 4;
-			r.h = piece_textures[p->c][p->t].h / 4;
-			board_index_to_screen_pos(x, y, &r.x, &r.y);
-			r.x += (TEXTURE_SIZE / 2) - piece_textures[p->c][p->t].x_center_offset / 4;
-			r.y += (TEXTURE_SIZE / 2) - piece_textures[p->c][p->t].y_center_offset / 4;
-			ASSERT_ERROR (!SDL_RenderCopy(renderer, piece_textures[p->c][p->t].t, NULL, &r), "SDL_RendererCopy failed: %s", SDL_GetError());
-		}
-	}
+	search_computer_move(arg);
+	SDL_zero(e);
+	e.type = computer_done_event;
+	ASSERT_ERROR (SDL_PushEvent(&e) >= 0, "SDL_PushEvent failed: %s", SDL_GetError());
+}
 
+void play_computer_move(chess *c)
+{
+	char move_string[6];
+
+	LOG_INFO ("Computer plays %s, score %d, depth %u, %llu nodes in %llu ms", move_to_string(computer_result.best_move, move_string),
+		computer_result.score, computer_result.depth, computer_result.nodes, computer_result.time_ns / 1000000);
+	ASSERT_ERROR (play_move(c, computer_result.best_move), "Search returned an illegal move");
+	// computers would play a known endgame out move by move, a human may still want to try
+	if (!c->is_game_over && is_computer_player[WHITE] && is_computer_player[BLACK] && bitbase_adjudicate(c))
+		LOG_INFO ("Game adjudicated by the bitbases");
+}
 
-	if (is_active_field && c->current_state.board[active_field.y][active_field.x].is_piece) {
-		board_index_to_screen_pos(active_field.x, active_field.y, &r.x, &r.y);
-		r.w = TEXTURE_SIZE;
-		r.h = TEXTURE_SIZE;
-		ASSERT_ERROR (!SDL_RenderCopy(renderer, highlight_texture, NULL, &r), "SDL_RendererCopy failed: %s", SDL_GetError());
+// returns true if the search runs on computer_thread, false if the move was played already
+bool start_computer_move(chess *c)
+{
+	char move_string[6];
+	move m = book.data ? book_pick(&book, &c->current_state, time_now_ns() * 0x9E3779B97F4A7C15ULL) : MOVE_NONE;
 
-		const dllist *moves = valid_moves_from(c, active_field);
-		dllist_apply((dllist *) moves, show_move_option);
-	} else {
-		is_active_field = false;
+	if (m != MOVE_NONE) {
+		LOG_INFO ("Computer plays book move %s", move_to_string(m, move_string));
+		ASSERT_ERROR (play_move(c, m), "Book returned an illegal move");
+		return false;
 	}
-	
 
-	SDL_RenderPresent(renderer);
+	atomic_store_u32(&stop_computer, 0);
+	if (computer_done_event != (Uint32) -1)
+		computer_thread = thread_start(computer_thread_run, c);
+	if (computer_thread)
+		return true;
+	search_computer_move(c);
+	play_computer_move(c);
+	return false;
+}
+
+// left arrow takes back moves until a human player is to move, right arrow plays them again
+void process_history_key(chess *c, SDL_Scancode key)
+{
+	if (key == SDL_SCANCODE_LEFT) {
+		while (undo_move(c) && is_computer_player[c->current_state.active_color]);
+		is_active_field = false;
+	}
+	if (key == SDL_SCANCODE_RIGHT) {
+		while (redo_move(c) && is_computer_player[c->current_state.active_color]);
+		is_active_field = false;
+	}
 }
 
-void process_input(chess *c) {
-	int x, y;
+void process_click(chess *c, int x, int y)
+{
 	int x_board, y_board;
-	SDL_PumpEvents();
-
-	if (SDL_GetMouseState(&x, &y) & SDL_BUTTON_LMASK) {
-		screen_pos_to_board_index(x, y, &x_board, &y_board);
-		if (!(0 <= x_board && x_board < BOARD_SIDE_LENGTH && 0 <= y_board && y_board < BOARD_SIDE_LENGTH))
-			is_active_field = false;
-		else {
-			if (!is_active_field || (x_board == active_field.x && y_board == active_field.y)) {
-				LOG_INFO("Got mouse click at %d %d", x, y);
-				is_active_field = true;
-				active_field.x = x_board;
-				active_field.y = y_board;
-			} else {
-				is_move_input = true;
-				move_input.x = x_board;
-				move_input.y = y_board;
-				if (!try_move(c, active_field, move_input)) {
-					is_active_field = x_board <= 0 && x_board < BOARD_SIDE_LENGTH&& y_board <= 0 && y_board < BOARD_SIDE_LENGTH;
-					if (is_active_field) {
-						active_field.x = x_board;
-						active_field.y = y_board;
-					}
+
+	screen_pos_to_board_index(x, y, &x_board, &y_board);
+	if (!(0 <= x_board && x_board < BOARD_SIDE_LENGTH && 0 <= y_board && y_board < BOARD_SIDE_LENGTH))
+		is_active_field = false;
+	else {
+		if (!is_active_field || (x_board == active_field.x && y_board == active_field.y)) {
+			LOG_INFO("Got mouse click at %d %d", x, y);
+			is_active_field = true;
+			active_field.x = x_board;
+			active_field.y = y_board;
+		} else {
+			is_move_input = true;
+			move_input.x = x_board;
+			move_input.y = y_board;
+			if (!try_move(c, active_field, move_input)) {
+				is_active_field = x_board <= 0 && x_board < BOARD_SIDE_LENGTH&& y_board <= 0 && y_board < BOARD_SIDE_LENGTH;
+				if (is_active_field) {
+					active_field.x = x_board;
+					active_field.y = y_board;
 				}
 			}
+		}
+
+	}
+}
+
+// returns false if the window was closed
+bool process_event(chess *c, const SDL_Event *e)
+{
+	if (e->type == computer_done_event) {
+		thread_join(computer_thread);
+		computer_thread = NULL;
+		play_computer_move(c);
+		return true;
+	}
 
+	switch (e->type) {
+	case SDL_QUIT:
+		return false;
+	case SDL_KEYDOWN:
+		// the game must not change while the computer searches it
+		if (!e->key.repeat && !computer_thread)
+			process_history_key(c, e->key.keysym.scancode);
+		break;
+	case SDL_MOUSEBUTTONDOWN:
+		// clicks queued while the computer is to move would play its move
+		if (e->button.button == SDL_BUTTON_LEFT && !is_computer_player[c->current_state.active_color])
+			process_click(c, e->button.x, e->button.y);
+		break;
+	case SDL_WINDOWEVENT:
+		if (e->window.event == SDL_WINDOWEVENT_EXPOSED || e->window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+			is_frame_valid = false;
+		break;
+	case SDL_RENDER_TARGETS_RESET:
+		is_frame_valid = false;
+		break;
+	}
+	return true;
+}
+
+void parse_arguments(int argc, char **argv)
+{
+	int i;
+
+	for (i = 1; i < argc; ++i) {
+		LOG_DEBUG ("%s", argv[i]);
+		if (!strcmp(argv[i], "-computer") && i + 1 < argc) {
+			++i;
+			is_computer_player[WHITE] = !strcmp(argv[i], "white") || !strcmp(argv[i], "both");
+			is_computer_player[BLACK] = !strcmp(argv[i], "black") || !strcmp(argv[i], "both");
+		} else if (!strcmp(argv[i], "-time") && i + 1 < argc) {
+			computer_time_ms = strtoull(argv[++i], NULL, 10);
+		} else if (!strcmp(argv[i], "-hash") && i + 1 < argc) {
+			hash_size_mb = strtoull(argv[++i], NULL, 10);
+		} else if (!strcmp(argv[i], "-threads") && i + 1 < argc) {
+			search_threads = (u32) strtoul(argv[++i], NULL, 10);
+		} else if (!strcmp(argv[i], "-vsync")) {
+			use_vsync = true;
+		} else if (!strcmp(argv[i], "-book") && i + 1 < argc) {
+			ASSERT_WARNING (book_open(&book, argv[++i]), "Could not open book %s, playing without", argv[i]);
+		} else if (!strcmp(argv[i], "-log") && i + 1 < argc) {
+			ASSERT_WARNING (log_parse_levels(argv[++i]), "Could not parse log levels %s, expected e.g. warning,search.c=debug", argv[i]);
+		} else {
+			LOG_WARNING ("Unknown argument %s, usage: %s [-computer white|black|both|none] [-time ms] [-hash MB] [-threads n] [-book file] [-vsync] [-log levels]", argv[i], argv[0]);
 		}
 	}
 }
@@ -170,25 +371,60 @@ void process_input(chess *c) {
 int main(int argc, char **argv)
 {
 	chess c;
+	SDL_Event e;
+	bool is_quit = false;
 	LOG_INFO ("Starting program");
 	LOG_DEBUG ("Got arguments:");
+	parse_arguments(argc, argv);
+	ASSERT_ERROR (tt_init(&tt, hash_size_mb), "Could not allocate %llu MB for the transposition table", hash_size_mb);
+	bitbases_init(BITBASE_FILE, search_threads ? search_threads : cpu_count());
 	
 	ASSERT_ERROR (!SDL_Init(SDL_INIT_EVERYTHING), "SDL_Init failed: %s", SDL_GetError());
 	init_game(&c);
 
-	while (!c.is_game_over) {
+	// nothing moves on its own, so the loop sleeps until an event arrives, including the end of the computer's search
+	while (!c.is_game_over && !is_quit) {
 		show_game(&c);
 
-		process_input(&c);
-		SDL_Delay(10);
+		// after a book move the loop looks at the next player at once
+		if (is_computer_player[c.current_state.active_color] && !computer_thread && !start_computer_move(&c))
+			continue;
+		if (SDL_WaitEvent(&e))
+			is_quit = !process_event(&c, &e);
+		else
+			LOG_WARNING ("SDL_WaitEvent failed: %s", SDL_GetError());
+		while (!is_quit && SDL_PollEvent(&e))
+			is_quit = !process_event(&c, &e);
+	}
+	// the window was closed while the computer was thinking
+	if (computer_thread) {
+		atomic_store_u32(&stop_computer, 1);
+		thread_join(computer_thread);
 	}
 
-	if (c.is_draw) {
+	if (!c.is_game_over) {
+		LOG_INFO ("Window closed during the game");
+	} else if (c.is_draw) {
 		LOG_INFO ("Game ended in draw!");
 	} else {
 		LOG_INFO ("%s won!", piece_color_string(c.winner));
 	}
 
 
+	free_chess(&c);
+	tt_free(&tt);
+	book_close(&book);
+	bitbases_free();
+	mem_log_stats();
+#if defined PROFILE
+	{
+		FILE *f = fopen(LOG_DIRECTORY "/profile.json", "w");
+		if (f) {
+			profile_write_json(f);
+			fclose(f);
+		}
+		ASSERT_WARNING (profile_write_trace(LOG_DIRECTORY "/trace.json"), "Could not write %s", LOG_DIRECTORY "/trace.json");
+	}
+#endif
 	return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include <stdlib.h>
+
+#include "log.h"
+#include "mem.h"
+#include "platform.h"
+#include "profile.h"
+
+typedef struct {
+	volatile u64 live_bytes;
+	volatile u64 live_allocations;
+	volatile u64 total_allocations;
+} mem_counters;
+
+static mem_counters counters[MEM_SUBSYSTEM_MAX];
+
+static void count_alloc(mem_subsystem s, size_t size);
+static void count_free(mem_subsystem s, size_t size);
+
+void *mem_alloc(mem_subsystem s, size_t size)
+{
+	void *p = malloc(size);
+
+	if (p)
+		count_alloc(s, size);
+	return p;
+}
+
+void *mem_calloc(mem_subsystem s, size_t num, size_t size)
+{
+	void *p = calloc(num, size);
+
+	if (p)
+		count_alloc(s, num * size);
+	return p;
+}
+
+void *mem_realloc(mem_subsystem s, void *p, size_t old_size, size_t size)
+{
+	void *q = realloc(p, size);
+
+	if (!q)
+		return NULL;
+	if (p)
+		count_free(s, old_size);
+	count_alloc(s, size);
+	return q;
+}
+
+void mem_free(mem_subsystem s, void *p, size_t size)
+{
+	if (!p)
+		return;
+	count_free(s, size);
+	free(p);
+}
+
+mem_stats *mem_get_stats(mem_subsystem s, mem_stats *stats)
+{
+	stats->live_bytes = counters[s].live_bytes;
+	stats->live_allocations = counters[s].live_allocations;
+	stats->total_allocations = counters[s].total_allocations;
+	return stats;
+}
+
+const char *mem_subsystem_string(mem_subsystem s)
+{
+	static const char *names[MEM_SUBSYSTEM_MAX] = { "containers", "arena", "game", "tt", "search", "perft", "epd", "pgn", "book", "bitbase" };
+	return s < MEM_SUBSYSTEM_MAX ? names[s] : "unknown";
+}
+
+void mem_log_stats(void)
+{
+	mem_subsystem s;
+	mem_stats stats;
+
+	for (s = 0; s < MEM_SUBSYSTEM_MAX; ++s) {
+		mem_get_stats(s, &stats);
+		LOG_INFO ("Memory of %-10s %12llu bytes in %8llu allocations, %llu allocations in total",
+			mem_subsystem_string(s), stats.live_bytes, stats.live_allocations, stats.total_allocations);
+	}
+}
+
+static void count_alloc(mem_subsystem s, size_t size)
+{
+	atomic_add_u64(&counters[s].live_bytes, size);
+	atomic_add_u64(&counters[s].live_allocations, 1);
+	atomic_add_u64(&counters[s].total_allocations, 1);
+	PROFILE_COUNT(PROFILE_ALLOCATIONS, 1);
+	PROFILE_COUNT(PROFILE_BYTES_ALLOCATED, size);
+}
+
+// unsigned addition wraps around, so adding the negated value subtracts
+static void count_free(mem_subsystem s, size_t size)
+{
+	atomic_add_u64(&counters[s].live_bytes, (u64) 0 - size);
+	atomic_add_u64(&counters[s].live_allocations, (u64) 0 - 1);
+}
@@ -0,0 +1,79 @@
+#ifndef MEM_H
+#define MEM_H
+
+#include <stddef.h>
+
+#include "types.h"
+
+/// <summary>
+/// Parts of the program whose heap memory is accounted separately
+/// </summary>
+typedef enum {
+	MEM_CONTAINERS, /* dllist nodes and vectors not assigned to another subsystem */
+	MEM_ARENA, /* blocks of arena allocators */
+	MEM_GAME, /* game records */
+	MEM_TT, /* transposition tables */
+	MEM_SEARCH, /* per thread search state */
+	MEM_PERFT, /* parallel perft tasks */
+	MEM_EPD, /* test suite workers */
+	MEM_PGN, /* game replay workers */
+	MEM_BOOK, /* opening book entries while building a book */
+	MEM_BITBASE, /* endgame bitbases and their generation */
+	MEM_SUBSYSTEM_MAX
+} mem_subsystem;
+
+/// <summary>
+/// Snapshot of the allocation counters of a subsystem
+/// </summary>
+typedef struct {
+	u64 live_bytes; /* allocated and not yet freed */
+	u64 live_allocations; /* blocks allocated and not yet freed */
+	u64 total_allocations; /* blocks allocated since program start, including reallocations */
+} mem_stats;
+
+/// <summary>
+/// malloc accounted to a subsystem. Thread safe.
+/// </summary>
+/// <returns>NULL if no memory is left</returns>
+void *mem_alloc(mem_subsystem s, size_t size);
+
+/// <summary>
+/// calloc accounted to a subsystem. Thread safe.
+/// </summary>
+/// <returns>NULL if no memory is left</returns>
+void *mem_calloc(mem_subsystem s, size_t num, size_t size);
+
+/// <summary>
+/// realloc accounted to a subsystem. Thread safe.
+/// </summary>
+/// <param name="s">subsystem p was allocated for</param>
+/// <param name="p">memory from mem_alloc, mem_calloc or mem_realloc, or NULL</param>
+/// <param name="old_size">size p was allocated with, 0 if p is NULL</param>
+/// <param name="size">new size</param>
+/// <returns>NULL if no memory is left, p is unchanged then</returns>
+void *mem_realloc(mem_subsystem s, void *p, size_t old_size, size_t size);
+
+/// <summary>
+/// free accounted to a subsystem. Thread safe.
+/// </summary>
+/// <param name="s">subsystem p was allocated for</param>
+/// <param name="p">memory from mem_alloc, mem_calloc or mem_realloc, or NULL</param>
+/// <param name="size">size p was allocated with</param>
+void mem_free(mem_subsystem s, void *p, size_t size);
+
+/// <summary>
+/// Read the counters of a subsystem
+/// </summary>
+/// <param name="s">subsystem</param>
+/// <param name="stats">receives the counters</param>
+/// <returns>stats</returns>
+mem_stats *mem_get_stats(mem_subsystem s, mem_stats *stats);
+
+const char *mem_subsystem_string(mem_subsystem s);
+
+/// <summary>
+/// Log the counters of all subsystems
+/// </summary>
+void mem_log_stats(void);
+
+#endif
@@ -0,0 +1,231 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "mem.h"
+#include "perft.h"
+#include "platform.h"
+#include "profile.h"
+
+/// subtree below two plies of the root, counted by one worker
+typedef struct {
+	move moves[2];
+	u32 root; /* index of moves[0] in the root move list */
+	u64 nodes;
+} perft_task;
+
+/// contiguous range of tasks owned by one worker; the owner takes from the front, thieves from the back
+typedef struct {
+	platform_mutex *lock;
+	u32 head;
+	u32 tail;
+} perft_queue;
+
+typedef struct perft_pool perft_pool;
+
+typedef struct {
+	perft_pool *pool;
+	u32 id;
+	chess_state state; /* private copy of the root position */
+	platform_thread *thread;
+} perft_worker;
+
+struct perft_pool {
+	perft_task *tasks;
+	perft_queue *queues;
+	perft_worker *workers;
+	u32 worker_num;
+	u32 depth; /* depth below the task moves */
+};
+
+const perft_position perft_positions[] = {
+	{ "initial position", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+		{ 20, 400, 8902, 197281, 4865609, 119060324 } },
+	{ "kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+		{ 48, 2039, 97862, 4085603, 193690690, 8031647685 } },
+	{ "rook endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+		{ 14, 191, 2812, 43238, 674624, 11030083 } },
+	{ "promotions", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+		{ 6, 264, 9467, 422333, 15833292, 706045033 } },
+	{ "discovered checks", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+		{ 44, 1486, 62379, 2103487, 89941194, 0 } },
+	{ "middlegame", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+		{ 46, 2079, 89890, 3894594, 164075551, 6923051137 } },
+};
+
+const u32 perft_position_num = sizeof (perft_positions) / sizeof (perft_positions[0]);
+
+u64 perft(chess_state *c, u32 depth)
+{
+	move_list moves;
+	move_undo u;
+	u64 nodes = 0;
+	u32 i;
+
+	if (depth == 0)
+		return 1;
+
+	generate_moves(c, &moves);
+	// the last ply does not need to be played, each legal move is one leaf
+	if (depth == 1)
+		return moves.size;
+
+	for (i = 0; i < moves.size; ++i) {
+		make_move(c, moves.moves[i], &u);
+		nodes += perft(c, depth - 1);
+		unmake_move(c, moves.moves[i], &u);
+	}
+	return nodes;
+}
+
+u64 perft_divide(chess_state *c, u32 depth, move_list *moves, u64 *nodes)
+{
+	move_undo u;
+	u64 total = 0;
+	u32 i;
+
+	ASSERT_ERROR (depth > 0, "perft_divide needs a depth of at least 1");
+
+	generate_moves(c, moves);
+	for (i = 0; i < moves->size; ++i) {
+		make_move(c, moves->moves[i], &u);
+		nodes[i] = perft(c, depth - 1);
+		unmake_move(c, moves->moves[i], &u);
+		total += nodes[i];
+	}
+	return total;
+}
+
+static bool next_task(perft_pool *pool, u32 id, u32 *task)
+{
+	perft_queue *q = &pool->queues[id];
+	bool found = false;
+	u32 i;
+
+	mutex_lock(q->lock);
+	if (q->head < q->tail) {
+		*task = q->head++;
+		found = true;
+	}
+	mutex_unlock(q->lock);
+
+	for (i = 1; !found && i < pool->worker_num; ++i) {
+		q = &pool->queues[(id + i) % pool->worker_num];
+		mutex_lock(q->lock);
+		if (q->head < q->tail) {
+			*task = --q->tail;
+			found = true;
+		}
+		mutex_unlock(q->lock);
+	}
+	return found;
+}
+
+static void perft_worker_run(void *arg)
+{
+	perft_worker *w = arg;
+	perft_pool *pool = w->pool;
+	perft_task *t;
+	move_undo u[2];
+	u32 i;
+
+	// tasks are never added while the workers run, so an empty round means everything is taken
+	while (next_task(pool, w->id, &i)) {
+		t = &pool->tasks[i];
+		make_move(&w->state, t->moves[0], &u[0]);
+		make_move(&w->state, t->moves[1], &u[1]);
+		t->nodes = perft(&w->state, pool->depth);
+		unmake_move(&w->state, t->moves[1], &u[1]);
+		unmake_move(&w->state, t->moves[0], &u[0]);
+	}
+}
+
+u64 perft_parallel(const chess_state *c, u32 depth, u32 thread_num, move_list *moves, u64 *nodes)
+{
+	perft_pool pool;
+	chess_state state = *c;
+	move_list root, replies;
+	move_undo u;
+	u64 total = 0;
+	u32 i, j, task_num = 0, started;
+	PROFILE_BEGIN(PROFILE_PERFT);
+
+	ASSERT_ERROR (thread_num > 0, "perft_parallel needs at least one thread");
+
+	if (!moves)
+		moves = &root;
+	generate_moves(&state, moves);
+	if (nodes)
+		memset(nodes, 0, moves->size * sizeof (u64));
+
+	// below two plies there is nothing worth sharing
+	if (depth < 3 || thread_num == 1) {
+		total = nodes ? perft_divide(&state, depth, moves, nodes) : perft(&state, depth);
+		PROFILE_END(PROFILE_PERFT);
+		return total;
+	}
+
+	for (i = 0; i < moves->size; ++i) {
+		make_move(&state, moves->moves[i], &u);
+		task_num += generate_moves(&state, &replies)->size;
+		unmake_move(&state, moves->moves[i], &u);
+	}
+
+	pool.tasks = mem_alloc(MEM_PERFT, (task_num ? task_num : 1) * sizeof (perft_task));
+	pool.queues = mem_calloc(MEM_PERFT, thread_num, sizeof (perft_queue));
+	pool.workers = mem_calloc(MEM_PERFT, thread_num, sizeof (perft_worker));
+	pool.worker_num = thread_num;
+	pool.depth = depth - 2;
+	ASSERT_ERROR (pool.tasks && pool.queues && pool.workers, "malloc returned NULL!");
+
+	task_num = 0;
+	for (i = 0; i < moves->size; ++i) {
+		make_move(&state, moves->moves[i], &u);
+		generate_moves(&state, &replies);
+		for (j = 0; j < replies.size; ++j) {
+			pool.tasks[task_num].moves[0] = moves->moves[i];
+			pool.tasks[task_num].moves[1] = replies.moves[j];
+			pool.tasks[task_num].root = i;
+			pool.tasks[task_num].nodes = 0;
+			++task_num;
+		}
+		unmake_move(&state, moves->moves[i], &u);
+	}
+
+	// neighbouring tasks share their root move, so every worker starts on a contiguous block
+	for (i = 0; i < thread_num; ++i) {
+		pool.queues[i].lock = mutex_create();
+		ASSERT_ERROR (pool.queues[i].lock, "mutex_create returned NULL!");
+		pool.queues[i].head = (u32) ((u64) task_num * i / thread_num);
+		pool.queues[i].tail = (u32) ((u64) task_num * (i + 1) / thread_num);
+		pool.workers[i].pool = &pool;
+		pool.workers[i].id = i;
+		pool.workers[i].state = state;
+	}
+
+	// the calling thread works as worker 0 and steals the queues of threads that failed to start
+	for (started = 1; started < thread_num; ++started) {
+		pool.workers[started].thread = thread_start(perft_worker_run, &pool.workers[started]);
+		if (!pool.workers[started].thread) {
+			LOG_WARNING ("Could only start %u of %u perft threads", started, thread_num);
+			break;
+		}
+	}
+	perft_worker_run(&pool.workers[0]);
+	for (i = 1; i < started; ++i)
+		thread_join(pool.workers[i].thread);
+
+	for (i = 0; i < task_num; ++i) {
+		total += pool.tasks[i].nodes;
+		if (nodes)
+			nodes[pool.tasks[i].root] += pool.tasks[i].nodes;
+	}
+
+	for (i = 0; i < thread_num; ++i)
+		mutex_destroy(pool.queues[i].lock);
+	mem_free(MEM_PERFT, pool.workers, thread_num * sizeof (perft_worker));
+	mem_free(MEM_PERFT, pool.queues, thread_num * sizeof (perft_queue));
+	mem_free(MEM_PERFT, pool.tasks, (task_num ? task_num : 1) * sizeof (perft_task));
+	PROFILE_END(PROFILE_PERFT);
+	return total;
+}
@@ -0,0 +1,58 @@
+#ifndef PERFT_H
+#define PERFT_H
+
+#include "chess.h"
+#include "types.h"
+
+#define PERFT_MAX_DEPTH 6
+
+/// <summary>
+/// Reference position with its known leaf node counts
+/// </summary>
+typedef struct {
+	const char *name; /* short description */
+	const char *fen; /* position in FEN */
+	u64 nodes[PERFT_MAX_DEPTH]; /* leaf nodes for depth 1 to PERFT_MAX_DEPTH, 0 if not listed */
+} perft_position;
+
+/// <summary>
+/// Standard perft reference positions
+/// </summary>
+extern const perft_position perft_positions[];
+
+/// <summary>
+/// Number of entries in perft_positions
+/// </summary>
+extern const u32 perft_position_num;
+
+/// <summary>
+/// Count the leaf nodes of the legal move tree of c up to depth
+/// </summary>
+/// <param name="c">game state, restored before returning</param>
+/// <param name="depth">number of plies</param>
+/// <returns>number of leaf nodes</returns>
+u64 perft(chess_state *c, u32 depth);
+
+/// <summary>
+/// Perft split by root moves
+/// </summary>
+/// <param name="c">game state, restored before returning</param>
+/// <param name="depth">number of plies including the root move, at least 1</param>
+/// <param name="moves">receives the root moves</param>
+/// <param name="nodes">receives the leaf node count below each root move, at least MOVE_LIST_CAPACITY entries</param>
+/// <returns>total number of leaf nodes</returns>
+u64 perft_divide(chess_state *c, u32 depth, move_list *moves, u64 *nodes);
+
+/// <summary>
+/// Multithreaded perft. The subtrees below the first two plies are handed out to thread_num
+/// workers, each counting on its own copy of c. Workers that run out of subtrees steal from the others.
+/// </summary>
+/// <param name="c">game state, not modified</param>
+/// <param name="depth">number of plies</param>
+/// <param name="thread_num">number of workers including the calling thread</param>
+/// <param name="moves">receives the root moves, may be NULL</param>
+/// <param name="nodes">receives the leaf node count below each root move like perft_divide, may be NULL</param>
+/// <returns>number of leaf nodes</returns>
+u64 perft_parallel(const chess_state *c, u32 depth, u32 thread_num, move_list *moves, u64 *nodes);
+
+#endif
@@ -0,0 +1,350 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "log.h"
+#include "mem.h"
+#include "pgn.h"
+#include "platform.h"
+
+#define PGN_TAG_MAX 128 /* longest tag value kept, FEN strings fit */
+
+typedef struct pgn_file pgn_file;
+
+typedef struct {
+	pgn_file *file;
+	chess game; /* replays every game of the worker, so its record is allocated only once */
+	chess_state initial; /* start position of games without FEN tag */
+	pgn_summary counts; /* totals of the games replayed by this worker */
+	platform_thread *thread;
+} pgn_worker;
+
+/// mapped file shared by the workers
+struct pgn_file {
+	const char *data;
+	u64 size;
+	u64 slice_num;
+	volatile u64 next_slice; /* slices handed out so far */
+	platform_mutex *lock; /* serializes the report and visit calls */
+	pgn_report report;
+	pgn_visit visit;
+	void *arg;
+};
+
+static void pgn_worker_run(void *arg);
+static const char *game_start(const pgn_file *f, u64 offset);
+static bool is_tag_pair(const char *p, const char *end);
+static bool follows_movetext(const pgn_file *f, const char *line);
+static const char *replay_game(pgn_worker *w, const char *p, const char *end);
+static const char *parse_tag(const char *p, const char *end, char *result, char *fen);
+static const char *skip_comment(const char *p, const char *end);
+static const char *read_token(const char *p, const char *end, char *token);
+static void finish_game(pgn_worker *w, pgn_game *g, const char *tag_result, const char *result);
+
+bool pgn_replay(const char *path, u32 thread_num, pgn_report report, pgn_visit visit, void *arg, pgn_summary *summary)
+{
+	pgn_file file = { NULL, 0, 0, 0, NULL, report, visit, arg };
+	pgn_worker *workers;
+	u64 start = time_now_ns();
+	u32 i, started;
+
+	ASSERT_ERROR (path && summary, "Argument path or summary is NULL");
+	memset(summary, 0, sizeof (pgn_summary));
+	if (!thread_num)
+		return false;
+	file.data = file_map(path, &file.size);
+	if (!file.data)
+		return false;
+	file.slice_num = (file.size + PGN_SLICE_BYTES - 1) / PGN_SLICE_BYTES;
+	file.lock = mutex_create();
+	ASSERT_ERROR (file.lock, "mutex_create returned NULL!");
+
+	workers = mem_calloc(MEM_PGN, thread_num, sizeof (pgn_worker));
+	ASSERT_ERROR (workers, "Could not allocate %u replay workers", thread_num);
+	for (i = 0; i < thread_num; ++i) {
+		workers[i].file = &file;
+		init_chess(&workers[i].game);
+		workers[i].initial = workers[i].game.current_state;
+	}
+
+	// the calling thread works as worker 0, the other workers only take slices which are left
+	for (started = 1; started < thread_num; ++started) {
+		workers[started].thread = thread_start(pgn_worker_run, &workers[started]);
+		if (!workers[started].thread) {
+			LOG_WARNING ("Could only start %u of %u replay threads", started, thread_num);
+			break;
+		}
+	}
+	pgn_worker_run(&workers[0]);
+	for (i = 1; i < started; ++i)
+		thread_join(workers[i].thread);
+
+	for (i = 0; i < thread_num; ++i) {
+		summary->games += workers[i].counts.games;
+		summary->plies += workers[i].counts.plies;
+		summary->illegal += workers[i].counts.illegal;
+		summary->wrong_result += workers[i].counts.wrong_result;
+		summary->invalid += workers[i].counts.invalid;
+		free_chess(&workers[i].game);
+	}
+	mem_free(MEM_PGN, workers, thread_num * sizeof (pgn_worker));
+	mutex_destroy(file.lock);
+	file_unmap(file.data, file.size);
+	summary->bytes = file.size;
+	summary->time_ns = time_now_ns() - start;
+	return true;
+}
+
+static void pgn_worker_run(void *arg)
+{
+	pgn_worker *w = arg;
+	pgn_file *f = w->file;
+	const char *p, *end;
+	u64 slice;
+
+	// neighbouring slices agree on the game boundary between them, so every game is replayed exactly once
+	while ((slice = atomic_add_u64(&f->next_slice, 1) - 1) < f->slice_num) {
+		p = game_start(f, slice * PGN_SLICE_BYTES);
+		end = game_start(f, (slice + 1) * PGN_SLICE_BYTES);
+		while (p < end)
+			p = replay_game(w, p, end);
+	}
+}
+
+// first game starting at or after offset: a line starting with a tag pair which follows movetext outside of a comment
+static const char *game_start(const pgn_file *f, u64 offset)
+{
+	const char *end = f->data + f->size, *p;
+
+	if (offset == 0)
+		return f->data;
+	if (offset >= f->size)
+		return end;
+
+	p = f->data + offset;
+	if (p[-1] != '\n')
+		for (; p < end && *p++ != '\n';);
+	while (p < end) {
+		if (is_tag_pair(p, end) && follows_movetext(f, p))
+			return p;
+		for (; p < end && *p++ != '\n';);
+	}
+	return end;
+}
+
+// [Name "value"], unlike the [%clk 0:01:00] commands and other brackets in comments
+static bool is_tag_pair(const char *p, const char *end)
+{
+	const char *name;
+
+	if (*p++ != '[')
+		return false;
+	for (name = p; p < end && ((*p >= 'A' && *p <= 'Z') || (*p >= 'a' && *p <= 'z') || (*p >= '0' && *p <= '9') || *p == '_'); ++p);
+	if (p == name || p == end || (*p != ' ' && *p != '\t'))
+		return false;
+	for (; p < end && (*p == ' ' || *p == '\t'); ++p);
+	return p < end && *p == '"';
+}
+
+// looks back over blank lines and the movetext up to the previous tags, a '{' without '}' after it opens a comment
+static bool follows_movetext(const pgn_file *f, const char *line)
+{
+	const char *start, *p;
+	bool movetext = false;
+
+	while (line > f->data) {
+		for (start = line - 1; start > f->data && start[-1] != '\n'; --start);
+		for (p = start; p < line && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'); ++p);
+		if (p < line) {
+			if (is_tag_pair(start, line))
+				return movetext;
+			for (p = line; p > start; --p) {
+				if (p[-1] == '{')
+					return false;
+				if (p[-1] == '}')
+					return true;
+			}
+			movetext = true;
+		}
+		line = start;
+	}
+	return movetext;
+}
+
+// replays the game starting at p, returns the position after it
+static const char *replay_game(pgn_worker *w, const char *p, const char *end)
+{
+	pgn_game g = { (u64) (p - w->file->data), PGN_GAME_OK, 0, "" };
+	char tag_result[PGN_TAG_MAX] = "", fen[PGN_TAG_MAX] = "", token[PGN_TOKEN_MAX], result[PGN_TOKEN_MAX] = "";
+	bool found = false, movetext = false;
+	chess_state start;
+	const char *s, *after;
+	move m;
+
+	while (p < end) {
+		if (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+			++p;
+			continue;
+		}
+		if (*p == '[') {
+			// the tags of the next game
+			if (movetext)
+				break;
+			found = true;
+			p = parse_tag(p, end, tag_result, fen);
+			continue;
+		}
+		if (*p == '{' || *p == ';' || *p == '(' || (*p == '%' && (p == w->file->data || p[-1] == '\n'))) {
+			p = skip_comment(p, end);
+			continue;
+		}
+
+		// the start position is known once the tags are done
+		if (!movetext) {
+			found = movetext = true;
+			if (!fen[0])
+				restart_chess(&w->game, &w->initial);
+			else if (chess_state_from_fen(&start, fen))
+				restart_chess(&w->game, &start);
+			else
+				g.status = PGN_GAME_INVALID_FEN;
+		}
+
+		p = read_token(p, end, token);
+		if (!strcmp(token, "1-0") || !strcmp(token, "0-1") || !strcmp(token, "1/2-1/2") || !strcmp(token, "*")) {
+			strcpy(result, token);
+			break;
+		}
+		if (token[0] == '$' || g.status != PGN_GAME_OK)
+			continue;
+
+		// move numbers may be attached to the move, "0-0" is castling
+		s = token;
+		if (strncmp(s, "0-0", 3))
+			for (; (*s >= '0' && *s <= '9') || *s == '.'; ++s);
+		if (!*s)
+			continue;
+		if (!parse_move_in_list(&w->game.current_state, &w->game.allowed_moves, s, &m, &after) || *after || !play_move(&w->game, m)) {
+			g.status = PGN_GAME_ILLEGAL_MOVE;
+			strcpy(g.token, token);
+			continue;
+		}
+		++g.ply;
+	}
+
+	if (found) {
+		if (!movetext && fen[0] && !chess_state_from_fen(&start, fen))
+			g.status = PGN_GAME_INVALID_FEN;
+		else if (!movetext)
+			restart_chess(&w->game, fen[0] ? &start : &w->initial);
+		finish_game(w, &g, tag_result, result);
+	}
+	return p;
+}
+
+// checks the result, counts the game and reports or visits it
+static void finish_game(pgn_worker *w, pgn_game *g, const char *tag_result, const char *result)
+{
+	const char *expected;
+
+	if (!result[0])
+		result = tag_result;
+	if (g->status == PGN_GAME_OK && tag_result[0] && strcmp(result, tag_result)) {
+		g->status = PGN_GAME_WRONG_RESULT;
+	} else if (g->status == PGN_GAME_OK && !w->game.allowed_moves.size) {
+		// mate and stalemate end the game, draws by repetition or the fifty-move rule have to be claimed
+		expected = w->game.is_draw ? "1/2-1/2" : w->game.winner == WHITE ? "1-0" : "0-1";
+		if (strcmp(result, expected))
+			g->status = PGN_GAME_WRONG_RESULT;
+	}
+	if (g->status == PGN_GAME_WRONG_RESULT)
+		snprintf(g->token, PGN_TOKEN_MAX, "%s", result[0] ? result : "none");
+	else if (g->status == PGN_GAME_OK)
+		snprintf(g->token, PGN_TOKEN_MAX, "%s", result);
+
+	++w->counts.games;
+	w->counts.plies += g->ply;
+	switch (g->status) {
+	case PGN_GAME_ILLEGAL_MOVE: ++w->counts.illegal; break;
+	case PGN_GAME_WRONG_RESULT: ++w->counts.wrong_result; break;
+	case PGN_GAME_INVALID_FEN: ++w->counts.invalid; break;
+	default: break;
+	}
+	if (g->status == PGN_GAME_OK ? !w->file->visit : !w->file->report)
+		return;
+
+	mutex_lock(w->file->lock);
+	if (g->status == PGN_GAME_OK)
+		w->file->visit(g, &w->game, w->file->arg);
+	else
+		w->file->report(g, w->file->arg);
+	mutex_unlock(w->file->lock);
+}
+
+// reads [Name "value"], keeping the values of Result and FEN
+static const char *parse_tag(const char *p, const char *end, char *result, char *fen)
+{
+	const char *name = ++p;
+	char *value = NULL;
+	size_t name_length, length = 0;
+
+	for (; p < end && *p != ' ' && *p != '"' && *p != ']' && *p != '\n'; ++p);
+	name_length = (size_t) (p - name);
+	if (name_length == 6 && !strncmp(name, "Result", 6))
+		value = result;
+	else if (name_length == 3 && !strncmp(name, "FEN", 3))
+		value = fen;
+
+	for (; p < end && *p != '"' && *p != ']' && *p != '\n'; ++p);
+	if (p < end && *p == '"') {
+		for (++p; p < end && *p != '"' && *p != '\n'; ++p) {
+			if (*p == '\\' && p + 1 < end)
+				++p;
+			if (value && length + 1 < PGN_TAG_MAX)
+				value[length++] = *p;
+		}
+		if (value)
+			value[length] = '\0';
+	}
+	for (; p < end && *p != ']' && *p != '\n'; ++p);
+	return p < end ? p + 1 : p;
+}
+
+// skips a {comment}, a ;comment or %escape line, or a (variation) with everything nested in it
+static const char *skip_comment(const char *p, const char *end)
+{
+	u32 depth = 0;
+
+	if (*p == ';' || *p == '%') {
+		for (; p < end && *p != '\n'; ++p);
+		return p;
+	}
+	if (*p == '{') {
+		for (; p < end && *p != '}'; ++p);
+		return p < end ? p + 1 : p;
+	}
+	for (; p < end; ++p) {
+		if (*p == '{')
+			p = skip_comment(p, end) - 1;
+		else if (*p == '(')
+			++depth;
+		else if (*p == ')' && --depth == 0)
+			return p + 1;
+	}
+	return p;
+}
+
+// copies the token at p, tokens end at white space and at the delimiters of tags, comments and variations
+static const char *read_token(const char *p, const char *end, char *token)
+{
+	u32 length = 0;
+
+	for (; p < end && !strchr(" \t\r\n[]{}();", *p); ++p) {
+		if (length + 1 < PGN_TOKEN_MAX)
+			token[length++] = *p;
+	}
+	token[length] = '\0';
+	// a token that stops at another delimiter has to be consumed to make progress
+	if (!length && p < end)
+		++p;
+	return p;
+}
@@ -0,0 +1,66 @@
+#ifndef PGN_H
+#define PGN_H
+
+#include "chess.h"
+#include "types.h"
+
+#define PGN_SLICE_BYTES (1 << 20) /* the file is handed to the workers in slices of about this size, cut at game boundaries */
+#define PGN_TOKEN_MAX 32 /* longer movetext tokens are reported as illegal moves */
+
+typedef enum {
+	PGN_GAME_OK,
+	PGN_GAME_ILLEGAL_MOVE, /* a move could not be parsed or is not legal */
+	PGN_GAME_WRONG_RESULT, /* the result contradicts a mate or stalemate on the board, or the Result tag */
+	PGN_GAME_INVALID_FEN /* the FEN tag could not be parsed */
+} pgn_status;
+
+/// <summary>
+/// A game that did not replay cleanly
+/// </summary>
+typedef struct {
+	u64 offset; /* position of the game in the file */
+	pgn_status status;
+	u32 ply; /* moves replayed before the illegal move, or all moves */
+	char token[PGN_TOKEN_MAX]; /* the illegal move, else the result of the game, empty if it has none */
+} pgn_game;
+
+/// <summary>
+/// Called for every game with a status other than PGN_GAME_OK, in the order the workers find them.
+/// Calls are serialized, so the callback needs no locking of its own.
+/// </summary>
+typedef void (*pgn_report)(const pgn_game *g, void *arg);
+
+/// <summary>
+/// Called for every game that replayed cleanly, with its moves in the game record of c.
+/// Calls are serialized like those of pgn_report. c must not be changed.
+/// </summary>
+typedef void (*pgn_visit)(const pgn_game *g, const chess *c, void *arg);
+
+/// <summary>
+/// Totals of a replay
+/// </summary>
+typedef struct {
+	u64 games;
+	u64 plies; /* moves replayed in all games */
+	u64 illegal; /* games with an illegal move */
+	u64 wrong_result; /* games with a result that does not match the final position */
+	u64 invalid; /* games whose start position could not be set up */
+	u64 bytes; /* size of the file */
+	u64 time_ns; /* wall clock time of the whole replay */
+} pgn_summary;
+
+/// <summary>
+/// Replay every game of a PGN file through play_move. The file is memory mapped and cut into slices at
+/// game boundaries, which thread_num workers parse in parallel, each with a single reused game record.
+/// Tags other than FEN and Result are ignored, as are comments, variations and NAGs.
+/// </summary>
+/// <param name="path">PGN file</param>
+/// <param name="thread_num">workers including the calling thread</param>
+/// <param name="report">called for each game that did not replay cleanly, may be NULL</param>
+/// <param name="visit">called for each game that did, may be NULL</param>
+/// <param name="arg">passed to report and visit</param>
+/// <param name="summary">receives the totals</param>
+/// <returns>false if the file could not be mapped</returns>
+bool pgn_replay(const char *path, u32 thread_num, pgn_report report, pgn_visit visit, void *arg, pgn_summary *summary);
+
+#endif
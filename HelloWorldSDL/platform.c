@@ -0,0 +1,419 @@
+#if !defined _WIN32
+// clock_gettime, CLOCK_MONOTONIC and nanosleep are POSIX, not ISO C
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined _MSC_VER
+#include <intrin.h>
+#elif defined __x86_64__ || defined __i386__
+#include <cpuid.h>
+#endif
+
+#if defined _WIN32
+#include <windows.h>
+#include <direct.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "platform.h"
+#include "profile.h"
+
+struct platform_thread {
+#if defined _WIN32
+	HANDLE handle;
+#else
+	pthread_t handle;
+#endif
+	thread_func func;
+	void *arg;
+};
+
+struct platform_mutex {
+#if defined _WIN32
+	CRITICAL_SECTION lock;
+#else
+	pthread_mutex_t lock;
+#endif
+};
+
+struct platform_event {
+#if defined _WIN32
+	HANDLE handle;
+#else
+	pthread_mutex_t lock;
+	pthread_cond_t condition;
+	bool is_signaled;
+#endif
+};
+
+u64 time_now_ns(void)
+{
+#if defined _WIN32
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+
+	// the frequency never changes, concurrent first calls store the same value
+	if (!frequency.QuadPart)
+		QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (u64) (counter.QuadPart / frequency.QuadPart) * 1000000000ULL
+		+ (u64) (counter.QuadPart % frequency.QuadPart) * 1000000000ULL / (u64) frequency.QuadPart;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64) ts.tv_sec * 1000000000ULL + (u64) ts.tv_nsec;
+#endif
+}
+
+u32 cpu_count(void)
+{
+#if defined _WIN32
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? (u32) info.dwNumberOfProcessors : 1;
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return n > 0 ? (u32) n : 1;
+#endif
+}
+
+bool cpu_has_fast_pext(void)
+{
+#if defined _M_X64 || defined __x86_64__
+	u32 r[4];
+	char vendor[13];
+	u32 family;
+
+#if defined _MSC_VER
+	__cpuid((int *) r, 0);
+#else
+	__cpuid(0, r[0], r[1], r[2], r[3]);
+#endif
+	if (r[0] < 7)
+		return false;
+	memcpy(vendor, &r[1], 4);
+	memcpy(vendor + 4, &r[3], 4);
+	memcpy(vendor + 8, &r[2], 4);
+	vendor[12] = '\0';
+
+#if defined _MSC_VER
+	__cpuidex((int *) r, 7, 0);
+#else
+	__cpuid_count(7, 0, r[0], r[1], r[2], r[3]);
+#endif
+	// BMI2 is bit 8 of ebx
+	if (!(r[1] & (1 << 8)))
+		return false;
+
+#if defined _MSC_VER
+	__cpuid((int *) r, 1);
+#else
+	__cpuid(1, r[0], r[1], r[2], r[3]);
+#endif
+	family = ((r[0] >> 8) & 0xF) + ((r[0] >> 20) & 0xFF);
+	return strcmp(vendor, "AuthenticAMD") || family >= 0x19;
+#else
+	return false;
+#endif
+}
+
+#if defined _WIN32
+static DWORD WINAPI thread_entry(LPVOID arg)
+{
+	platform_thread *t = arg;
+
+	t->func(t->arg);
+#if defined PROFILE
+	profile_release_thread();
+#endif
+	return 0;
+}
+#else
+static void *thread_entry(void *arg)
+{
+	platform_thread *t = arg;
+
+	t->func(t->arg);
+#if defined PROFILE
+	profile_release_thread();
+#endif
+	return NULL;
+}
+#endif
+
+platform_thread *thread_start(thread_func func, void *arg)
+{
+	platform_thread *t = malloc(sizeof (platform_thread));
+
+	if (!t)
+		return NULL;
+	t->func = func;
+	t->arg = arg;
+#if defined _WIN32
+	t->handle = CreateThread(NULL, 0, thread_entry, t, 0, NULL);
+	if (!t->handle) {
+		free(t);
+		return NULL;
+	}
+#else
+	if (pthread_create(&t->handle, NULL, thread_entry, t)) {
+		free(t);
+		return NULL;
+	}
+#endif
+	return t;
+}
+
+void thread_join(platform_thread *t)
+{
+#if defined _WIN32
+	WaitForSingleObject(t->handle, INFINITE);
+	CloseHandle(t->handle);
+#else
+	pthread_join(t->handle, NULL);
+#endif
+	free(t);
+}
+
+void thread_sleep_ms(u32 ms)
+{
+#if defined _WIN32
+	Sleep(ms);
+#else
+	struct timespec ts = { ms / 1000, (long) (ms % 1000) * 1000000 };
+
+	// nanosleep would wait for the timer slack even for 0
+	if (!ms) {
+		sched_yield();
+		return;
+	}
+	while (nanosleep(&ts, &ts) && errno == EINTR);
+#endif
+}
+
+bool create_directory(const char *path)
+{
+#if defined _WIN32
+	DWORD attributes;
+
+	if (!_mkdir(path))
+		return true;
+	attributes = GetFileAttributesA(path);
+	return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+	struct stat st;
+
+	return !mkdir(path, 0777) || (!stat(path, &st) && S_ISDIR(st.st_mode));
+#endif
+}
+
+const void *file_map(const char *path, u64 *size)
+{
+#if defined _WIN32
+	HANDLE file, mapping;
+	LARGE_INTEGER file_size;
+	const void *p = NULL;
+
+	file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+	if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+		// the view keeps the mapping and the file open after their handles are closed
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping) {
+			p = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping);
+		}
+	}
+	CloseHandle(file);
+	*size = p ? (u64) file_size.QuadPart : 0;
+	return p;
+#else
+	struct stat st;
+	void *p = MAP_FAILED;
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0)
+		return NULL;
+	if (!fstat(fd, &st) && st.st_size > 0)
+		p = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		*size = 0;
+		return NULL;
+	}
+	*size = (u64) st.st_size;
+	return p;
+#endif
+}
+
+void file_unmap(const void *p, u64 size)
+{
+	if (!p)
+		return;
+#if defined _WIN32
+	(void) size;
+	UnmapViewOfFile(p);
+#else
+	munmap((void *) p, (size_t) size);
+#endif
+}
+
+platform_mutex *mutex_create(void)
+{
+	platform_mutex *m = malloc(sizeof (platform_mutex));
+
+	if (!m)
+		return NULL;
+#if defined _WIN32
+	InitializeCriticalSection(&m->lock);
+#else
+	if (pthread_mutex_init(&m->lock, NULL)) {
+		free(m);
+		return NULL;
+	}
+#endif
+	return m;
+}
+
+void mutex_destroy(platform_mutex *m)
+{
+#if defined _WIN32
+	DeleteCriticalSection(&m->lock);
+#else
+	pthread_mutex_destroy(&m->lock);
+#endif
+	free(m);
+}
+
+void mutex_lock(platform_mutex *m)
+{
+#if defined _WIN32
+	EnterCriticalSection(&m->lock);
+#else
+	pthread_mutex_lock(&m->lock);
+#endif
+}
+
+void mutex_unlock(platform_mutex *m)
+{
+#if defined _WIN32
+	LeaveCriticalSection(&m->lock);
+#else
+	pthread_mutex_unlock(&m->lock);
+#endif
+}
+
+platform_event *event_create(void)
+{
+	platform_event *e = malloc(sizeof (platform_event));
+
+	if (!e)
+		return NULL;
+#if defined _WIN32
+	e->handle = CreateEventA(NULL, FALSE, FALSE, NULL);
+	if (!e->handle) {
+		free(e);
+		return NULL;
+	}
+#else
+	e->is_signaled = false;
+	if (pthread_mutex_init(&e->lock, NULL)) {
+		free(e);
+		return NULL;
+	}
+	if (pthread_cond_init(&e->condition, NULL)) {
+		pthread_mutex_destroy(&e->lock);
+		free(e);
+		return NULL;
+	}
+#endif
+	return e;
+}
+
+void event_destroy(platform_event *e)
+{
+#if defined _WIN32
+	CloseHandle(e->handle);
+#else
+	pthread_cond_destroy(&e->condition);
+	pthread_mutex_destroy(&e->lock);
+#endif
+	free(e);
+}
+
+void event_signal(platform_event *e)
+{
+#if defined _WIN32
+	SetEvent(e->handle);
+#else
+	pthread_mutex_lock(&e->lock);
+	e->is_signaled = true;
+	pthread_cond_signal(&e->condition);
+	pthread_mutex_unlock(&e->lock);
+#endif
+}
+
+void event_wait(platform_event *e)
+{
+#if defined _WIN32
+	WaitForSingleObject(e->handle, INFINITE);
+#else
+	pthread_mutex_lock(&e->lock);
+	// pthread_cond_wait may return without a signal
+	while (!e->is_signaled)
+		pthread_cond_wait(&e->condition, &e->lock);
+	e->is_signaled = false;
+	pthread_mutex_unlock(&e->lock);
+#endif
+}
+
+u64 atomic_add_u64(volatile u64 *p, u64 v)
+{
+#if defined _WIN32
+	return (u64) InterlockedExchangeAdd64((volatile LONG64 *) p, (LONG64) v) + v;
+#else
+	return __atomic_add_fetch(p, v, __ATOMIC_SEQ_CST);
+#endif
+}
+
+u32 atomic_load_u32(const volatile u32 *p)
+{
+#if defined _WIN32
+	return (u32) InterlockedCompareExchange((volatile LONG *) p, 0, 0);
+#else
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#endif
+}
+
+void atomic_store_u32(volatile u32 *p, u32 v)
+{
+#if defined _WIN32
+	InterlockedExchange((volatile LONG *) p, (LONG) v);
+#else
+	__atomic_store_n(p, v, __ATOMIC_RELEASE);
+#endif
+}
+
+bool atomic_cas_u32(volatile u32 *p, u32 expected, u32 desired)
+{
+#if defined _WIN32
+	return (u32) InterlockedCompareExchange((volatile LONG *) p, (LONG) desired, (LONG) expected) == expected;
+#else
+	return __atomic_compare_exchange_n(p, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
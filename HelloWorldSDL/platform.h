@@ -0,0 +1,140 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include "types.h"
+
+/// <summary>
+/// Operating system thread, created by thread_start and released by thread_join
+/// </summary>
+typedef struct platform_thread platform_thread;
+
+/// <summary>
+/// Non recursive mutual exclusion lock
+/// </summary>
+typedef struct platform_mutex platform_mutex;
+
+/// <summary>
+/// Auto reset event, a signal wakes one waiting thread or lets the next wait return at once
+/// </summary>
+typedef struct platform_event platform_event;
+
+/// <summary>
+/// Entry point of a thread
+/// </summary>
+typedef void (*thread_func)(void *arg);
+
+/// <summary>
+/// Monotonic clock for measuring durations
+/// </summary>
+/// <returns>nanoseconds since an unspecified starting point</returns>
+u64 time_now_ns(void);
+
+/// <summary>
+/// Number of logical processors available to this process
+/// </summary>
+/// <returns>at least 1</returns>
+u32 cpu_count(void);
+
+/// <summary>
+/// Check if the processor has the BMI2 PEXT instruction and executes it in hardware.
+/// AMD processors before Zen 3 implement it in microcode, which is slower than a multiplication.
+/// </summary>
+bool cpu_has_fast_pext(void);
+
+/// <summary>
+/// Runs func(arg) on a new thread
+/// </summary>
+/// <returns>thread handle or NULL on failure</returns>
+platform_thread *thread_start(thread_func func, void *arg);
+
+/// <summary>
+/// Waits until t has finished and releases it
+/// </summary>
+void thread_join(platform_thread *t);
+
+/// <summary>
+/// Suspends the calling thread, 0 only lets other threads run
+/// </summary>
+void thread_sleep_ms(u32 ms);
+
+/// <summary>
+/// Creates a directory, its parent has to exist
+/// </summary>
+/// <returns>true if the directory exists afterwards</returns>
+bool create_directory(const char *path);
+
+/// <summary>
+/// Maps a whole file into memory for reading. Pages are loaded when they are first touched,
+/// so even files larger than the available memory can be read this way.
+/// </summary>
+/// <param name="path">file to map</param>
+/// <param name="size">receives the size of the file</param>
+/// <returns>start of the read only mapping, NULL on failure or if the file is empty</returns>
+const void *file_map(const char *path, u64 *size);
+
+/// <summary>
+/// Releases a mapping created by file_map
+/// </summary>
+/// <param name="p">start of the mapping</param>
+/// <param name="size">size returned by file_map</param>
+void file_unmap(const void *p, u64 size);
+
+/// <summary>
+/// Creates an unlocked mutex
+/// </summary>
+/// <returns>mutex or NULL on failure</returns>
+platform_mutex *mutex_create(void);
+
+/// <summary>
+/// Releases an unlocked mutex
+/// </summary>
+void mutex_destroy(platform_mutex *m);
+
+void mutex_lock(platform_mutex *m);
+
+void mutex_unlock(platform_mutex *m);
+
+/// <summary>
+/// Creates an event which is not signaled
+/// </summary>
+/// <returns>event or NULL on failure</returns>
+platform_event *event_create(void);
+
+/// <summary>
+/// Releases an event no thread waits for
+/// </summary>
+void event_destroy(platform_event *e);
+
+/// <summary>
+/// Wakes one thread waiting for e, or keeps the signal for the next event_wait if none is waiting
+/// </summary>
+void event_signal(platform_event *e);
+
+/// <summary>
+/// Blocks until e is signaled and resets it
+/// </summary>
+void event_wait(platform_event *e);
+
+/// <summary>
+/// Atomically add v to *p
+/// </summary>
+/// <returns>the new value of *p</returns>
+u64 atomic_add_u64(volatile u64 *p, u64 v);
+
+/// <summary>
+/// Read a flag written by another thread, sees everything written before the matching atomic_store_u32
+/// </summary>
+u32 atomic_load_u32(const volatile u32 *p);
+
+/// <summary>
+/// Write a flag read by other threads with atomic_load_u32
+/// </summary>
+void atomic_store_u32(volatile u32 *p, u32 v);
+
+/// <summary>
+/// Atomically replace *p by desired if it equals expected
+/// </summary>
+/// <returns>true if *p was replaced</returns>
+bool atomic_cas_u32(volatile u32 *p, u32 expected, u32 desired);
+
+#endif
@@ -0,0 +1,199 @@
+#include <string.h>
+
+#include "profile.h"
+
+typedef struct {
+	u64 start; /* time_now_ns at the start of the scope */
+	u64 duration_ns;
+	u32 thread;
+	profile_timer timer;
+} profile_event;
+
+static const char *counter_names[PROFILE_COUNTER_MAX] = {
+	"generate_calls", "moves_generated", "moves_filtered", "make_moves", "allocations", "bytes_allocated", "bytes_copied"
+};
+
+static const char *timer_names[PROFILE_TIMER_MAX] = {
+	"play_move", "record", "make_move", "game_status", "seek", "search", "perft"
+};
+
+#if defined PROFILE
+
+PROFILE_THREAD_LOCAL profile_thread *profile_current;
+
+static profile_thread threads[PROFILE_THREAD_MAX];
+static volatile u32 is_thread_used[PROFILE_THREAD_MAX];
+static profile_thread released; /* sums of the threads which have exited, only changed atomically */
+static PROFILE_THREAD_LOCAL profile_thread overflow; /* counters of a thread which found every slot taken */
+static volatile u64 thread_num; /* threads registered since the last reset */
+static profile_event events[PROFILE_TRACE_CAPACITY];
+static volatile u64 event_num; /* events recorded or dropped */
+
+// slots of exited threads are reused, so the trace shows them as one thread
+profile_thread *profile_register_thread(void)
+{
+	u32 i;
+
+	atomic_add_u64(&thread_num, 1);
+	for (i = 0; i < PROFILE_THREAD_MAX; ++i) {
+		if (atomic_cas_u32(&is_thread_used[i], 0, 1)) {
+			threads[i].id = i;
+			profile_current = &threads[i];
+			return profile_current;
+		}
+	}
+	// only added to the total when the thread exits
+	memset(&overflow, 0, sizeof (overflow));
+	overflow.id = PROFILE_THREAD_MAX;
+	profile_current = &overflow;
+	return profile_current;
+}
+
+void profile_release_thread(void)
+{
+	profile_thread *t = profile_current;
+	u32 i;
+
+	if (!t)
+		return;
+	for (i = 0; i < PROFILE_COUNTER_MAX; ++i)
+		atomic_add_u64(&released.counters[i], t->counters[i]);
+	for (i = 0; i < PROFILE_TIMER_MAX; ++i) {
+		atomic_add_u64(&released.timer_ns[i], t->timer_ns[i]);
+		atomic_add_u64(&released.timer_calls[i], t->timer_calls[i]);
+	}
+	profile_current = NULL;
+	if (t == &overflow)
+		return;
+	memset(t->counters, 0, sizeof (t->counters));
+	memset(t->timer_ns, 0, sizeof (t->timer_ns));
+	memset(t->timer_calls, 0, sizeof (t->timer_calls));
+	atomic_store_u32(&is_thread_used[t->id], 0);
+}
+
+void profile_end(profile_timer timer, u64 start)
+{
+	profile_thread *t = profile_data();
+	u64 duration = time_now_ns() - start;
+	u64 i;
+
+	t->timer_ns[timer] += duration;
+	++t->timer_calls[timer];
+
+	i = atomic_add_u64(&event_num, 1) - 1;
+	if (i < PROFILE_TRACE_CAPACITY)
+		events[i] = (profile_event) { start, duration, t->id, timer };
+}
+
+// counters of running threads may be changed while they are reset
+void profile_reset(void)
+{
+	u32 i;
+
+	for (i = 0; i < PROFILE_THREAD_MAX; ++i) {
+		memset(threads[i].counters, 0, sizeof (threads[i].counters));
+		memset(threads[i].timer_ns, 0, sizeof (threads[i].timer_ns));
+		memset(threads[i].timer_calls, 0, sizeof (threads[i].timer_calls));
+	}
+	memset(&released, 0, sizeof (released));
+	thread_num = 0;
+	event_num = 0;
+}
+
+profile_thread *profile_total(profile_thread *total)
+{
+	u32 i, j;
+
+	*total = released;
+	for (i = 0; i < PROFILE_THREAD_MAX; ++i) {
+		for (j = 0; j < PROFILE_COUNTER_MAX; ++j)
+			total->counters[j] += threads[i].counters[j];
+		for (j = 0; j < PROFILE_TIMER_MAX; ++j) {
+			total->timer_ns[j] += threads[i].timer_ns[j];
+			total->timer_calls[j] += threads[i].timer_calls[j];
+		}
+	}
+	total->id = (u32) thread_num;
+	return total;
+}
+
+bool profile_write_json(FILE *f)
+{
+	profile_thread total;
+	u32 i;
+
+	profile_total(&total);
+	fprintf(f, "{\n\t\"threads\": %u,\n\t\"counters\": {", total.id);
+	for (i = 0; i < PROFILE_COUNTER_MAX; ++i)
+		fprintf(f, "%s\n\t\t\"%s\": %llu", i ? "," : "", counter_names[i], (unsigned long long) total.counters[i]);
+	fprintf(f, "\n\t},\n\t\"timers\": {");
+	for (i = 0; i < PROFILE_TIMER_MAX; ++i) {
+		fprintf(f, "%s\n\t\t\"%s\": { \"calls\": %llu, \"total_ns\": %llu }", i ? "," : "", timer_names[i],
+			(unsigned long long) total.timer_calls[i], (unsigned long long) total.timer_ns[i]);
+	}
+	fprintf(f, "\n\t},\n\t\"trace_events\": %llu,\n\t\"trace_events_dropped\": %llu\n}\n",
+		(unsigned long long) (event_num < PROFILE_TRACE_CAPACITY ? event_num : PROFILE_TRACE_CAPACITY),
+		(unsigned long long) (event_num > PROFILE_TRACE_CAPACITY ? event_num - PROFILE_TRACE_CAPACITY : 0));
+	return !ferror(f);
+}
+
+// complete events ("ph": "X") with microsecond timestamps relative to the first event
+bool profile_write_trace(const char *path)
+{
+	u64 n = event_num < PROFILE_TRACE_CAPACITY ? event_num : PROFILE_TRACE_CAPACITY;
+	u64 i, origin = ~(u64) 0;
+	FILE *f = fopen(path, "w");
+	bool ok;
+
+	if (!f)
+		return false;
+	for (i = 0; i < n; ++i) {
+		if (events[i].start < origin)
+			origin = events[i].start;
+	}
+
+	fprintf(f, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+	for (i = 0; i < n; ++i) {
+		fprintf(f, "%s\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}", i ? "," : "",
+			timer_names[events[i].timer], events[i].thread, (events[i].start - origin) / 1000.0, events[i].duration_ns / 1000.0);
+	}
+	fprintf(f, "\n]}\n");
+	ok = !ferror(f);
+	return !fclose(f) && ok;
+}
+
+#else
+
+void profile_reset(void)
+{
+}
+
+profile_thread *profile_total(profile_thread *total)
+{
+	memset(total, 0, sizeof (profile_thread));
+	return total;
+}
+
+bool profile_write_json(FILE *f)
+{
+	(void) f;
+	return false;
+}
+
+bool profile_write_trace(const char *path)
+{
+	(void) path;
+	return false;
+}
+
+#endif // defined PROFILE
+
+const char *profile_counter_string(profile_counter counter)
+{
+	return counter < PROFILE_COUNTER_MAX ? counter_names[counter] : "unknown";
+}
+
+const char *profile_timer_string(profile_timer timer)
+{
+	return timer < PROFILE_TIMER_MAX ? timer_names[timer] : "unknown";
+}
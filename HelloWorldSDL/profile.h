@@ -0,0 +1,122 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+
+#include "platform.h"
+#include "types.h"
+
+// Build with PROFILE defined to enable the counters and timers below. Without it the macros
+// expand to nothing and their arguments are not evaluated.
+
+#define PROFILE_THREAD_MAX 64 /* running threads whose counters can be read while they run, more are added when they exit */
+#define PROFILE_TRACE_CAPACITY (1 << 20) /* timer events kept for the trace file, later ones are dropped */
+
+typedef enum {
+	PROFILE_GENERATE_CALLS, /* generate_moves calls */
+	PROFILE_MOVES_GENERATED, /* legal moves added to move lists */
+	PROFILE_MOVES_FILTERED, /* pseudo legal moves dropped for leaving the king in check */
+	PROFILE_MAKE_MOVES, /* make_move calls */
+	PROFILE_ALLOCATIONS, /* mem_alloc, mem_calloc and mem_realloc calls */
+	PROFILE_BYTES_ALLOCATED,
+	PROFILE_BYTES_COPIED, /* game states copied as a whole */
+	PROFILE_COUNTER_MAX
+} profile_counter;
+
+typedef enum {
+	PROFILE_PLAY_MOVE, /* play_move including the phases below */
+	PROFILE_RECORD, /* storing the move in the game record */
+	PROFILE_MAKE_MOVE, /* updating the state and the position history */
+	PROFILE_GAME_STATUS, /* generating the legal moves and detecting the end of the game */
+	PROFILE_SEEK, /* seek_ply */
+	PROFILE_SEARCH, /* search_parallel */
+	PROFILE_PERFT, /* perft_parallel */
+	PROFILE_TIMER_MAX
+} profile_timer;
+
+/// <summary>
+/// Counters of one thread, so counting needs no atomic operations
+/// </summary>
+typedef struct {
+	u64 counters[PROFILE_COUNTER_MAX];
+	u64 timer_ns[PROFILE_TIMER_MAX]; /* total time spent in each timer */
+	u64 timer_calls[PROFILE_TIMER_MAX];
+	u32 id; /* thread number in the trace */
+} profile_thread;
+
+#if defined PROFILE
+
+#if defined _MSC_VER
+#define PROFILE_THREAD_LOCAL __declspec(thread)
+#else
+#define PROFILE_THREAD_LOCAL __thread
+#endif
+
+extern PROFILE_THREAD_LOCAL profile_thread *profile_current;
+
+/// <summary>
+/// Assign counters to the calling thread
+/// </summary>
+profile_thread *profile_register_thread(void);
+
+/// <summary>
+/// Add the counters of the calling thread to the total and free them for the next thread.
+/// thread_start calls it when the thread function returns.
+/// </summary>
+void profile_release_thread(void);
+
+static inline profile_thread *profile_data(void)
+{
+	return profile_current ? profile_current : profile_register_thread();
+}
+
+/// <summary>
+/// Add the time since start to a timer and record it for the trace file
+/// </summary>
+void profile_end(profile_timer timer, u64 start);
+
+#define PROFILE_COUNT(counter, n) (profile_data()->counters[counter] += (u64) (n))
+
+/* declares the start time of a scope, has to come after the other declarations of the block */
+#define PROFILE_BEGIN(timer) u64 profile_start_##timer = time_now_ns()
+
+#define PROFILE_END(timer) profile_end(timer, profile_start_##timer)
+
+#else
+
+#define PROFILE_COUNT(counter, n) ((void) 0)
+#define PROFILE_BEGIN(timer)
+#define PROFILE_END(timer) ((void) 0)
+
+#endif // defined PROFILE
+
+/// <summary>
+/// Zero all counters and timers and drop the recorded trace events
+/// </summary>
+void profile_reset(void);
+
+/// <summary>
+/// Sum of the counters and timers of all threads
+/// </summary>
+/// <param name="total">receives the sums, id is the number of threads</param>
+/// <returns>total</returns>
+profile_thread *profile_total(profile_thread *total);
+
+/// <summary>
+/// Write the summed counters and timers as a JSON object
+/// </summary>
+/// <returns>false if PROFILE is not defined or writing failed</returns>
+bool profile_write_json(FILE *f);
+
+/// <summary>
+/// Write the recorded timer events in the Trace Event Format, which chrome://tracing and Perfetto open
+/// </summary>
+/// <param name="path">file to create</param>
+/// <returns>false if PROFILE is not defined or the file could not be written</returns>
+bool profile_write_trace(const char *path);
+
+const char *profile_counter_string(profile_counter counter);
+
+const char *profile_timer_string(profile_timer timer);
+
+#endif
@@ -0,0 +1,450 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitbase.h"
+#include "eval.h"
+#include "log.h"
+#include "mem.h"
+#include "platform.h"
+#include "profile.h"
+#include "search.h"
+
+#define STOP_CHECK_INTERVAL 1024 /* nodes between two looks at the clock */
+#define ORDER_TT_MOVE (1 << 30)
+#define ORDER_CAPTURE (1 << 28)
+#define ORDER_KILLER (1 << 27)
+#define HISTORY_MAX (1 << 26)
+
+/// state all threads of a search share
+typedef struct {
+	volatile u32 stop; /* set when the main thread is done or a limit is reached */
+	volatile u64 nodes; /* nodes of all threads, updated every STOP_CHECK_INTERVAL nodes */
+} search_shared;
+
+/// state of one search thread
+typedef struct {
+	u32 id; /* 0 is the main thread, which decides the result */
+	search_shared *shared;
+	platform_thread *thread;
+	chess_state state;
+	transposition_table *tt;
+	search_limits limits;
+	u64 deadline; /* time_now_ns() value to stop at, 0 if none */
+	u64 nodes;
+	u64 nodes_reported; /* part of nodes already added to shared->nodes */
+	bool stop;
+	search_result *result; /* main thread only */
+	u64 start;
+	move killers[SEARCH_MAX_PLY][2]; /* quiet moves which caused a cutoff at this ply */
+	i32 history[COLOR_MAX][SQUARE_NUM][SQUARE_NUM]; /* cutoff score of quiet moves by from and to square */
+	move pv[SEARCH_MAX_PLY][SEARCH_MAX_PLY]; /* triangular table, pv[ply] is the variation from ply on */
+	u32 pv_length[SEARCH_MAX_PLY];
+	u64 keys[POSITION_HISTORY_CAPACITY + SEARCH_MAX_PLY]; /* keys of the positions before the current one */
+	u32 key_count;
+	bool is_root_known; /* the bitbase covers the root, so only its draws end the search early */
+} search_context;
+
+static void iterative_deepening(void *arg);
+static i32 alpha_beta(search_context *s, i32 depth, u32 ply, i32 alpha, i32 beta);
+static i32 quiescence(search_context *s, u32 ply, i32 alpha, i32 beta);
+static bool should_stop(search_context *s);
+static bool is_draw(const search_context *s);
+static bool probe_bitbase(const search_context *s, u32 ply, i32 *score);
+static void order_moves(const search_context *s, const move_list *moves, i32 *scores, move tt_move, u32 ply);
+static move pick_move(move_list *moves, i32 *scores, u32 i);
+static void update_pv(search_context *s, u32 ply, move m);
+static void update_quiet_stats(search_context *s, move m, u32 ply, i32 depth);
+static i32 score_to_tt(i32 score, u32 ply);
+static i32 score_from_tt(i32 score, u32 ply);
+
+search_result *search(const chess_state *c, const position_history *history, transposition_table *tt, const search_limits *limits, search_result *result)
+{
+	return search_parallel(c, history, tt, limits, 1, result);
+}
+
+search_result *search_parallel(const chess_state *c, const position_history *history, transposition_table *tt, const search_limits *limits, u32 thread_num, search_result *result)
+{
+	search_shared shared = { 0, 0 };
+	search_context *threads;
+	move_list moves;
+	piece_color winner;
+	u64 start = time_now_ns();
+	u32 i, started;
+	bool is_root_known;
+	PROFILE_BEGIN(PROFILE_SEARCH);
+
+	ASSERT_ERROR (c && tt && limits && result, "Argument was NULL");
+	is_root_known = bitbase_probe(c, &winner) != BITBASE_NONE;
+
+	if (!thread_num)
+		thread_num = 1;
+	threads = mem_calloc(MEM_SEARCH, thread_num, sizeof (search_context));
+	ASSERT_ERROR (threads, "calloc returned NULL!");
+
+	memset(result, 0, sizeof (search_result));
+	// something to play even if the first iteration does not finish
+	generate_moves(c, &moves);
+	result->best_move = moves.size ? moves.moves[0] : MOVE_NONE;
+	if (!moves.size) {
+		mem_free(MEM_SEARCH, threads, thread_num * sizeof (search_context));
+		PROFILE_END(PROFILE_SEARCH);
+		return result;
+	}
+
+	tt_new_search(tt);
+	for (i = 0; i < thread_num; ++i) {
+		threads[i].id = i;
+		threads[i].shared = &shared;
+		threads[i].state = *c;
+		PROFILE_COUNT(PROFILE_BYTES_COPIED, sizeof (chess_state));
+		threads[i].tt = tt;
+		threads[i].limits = *limits;
+		threads[i].deadline = limits->time_limit_ns ? start + limits->time_limit_ns : 0;
+		threads[i].start = start;
+		threads[i].is_root_known = is_root_known;
+		// the last key of the game history is c itself
+		if (history && history->size > 1) {
+			threads[i].key_count = history->size - 1;
+			memcpy(threads[i].keys, history->keys, threads[i].key_count * sizeof (u64));
+		}
+	}
+	threads[0].result = result;
+
+	// helpers search the same root and only share their results through the transposition table
+	for (started = 1; started < thread_num; ++started) {
+		threads[started].thread = thread_start(iterative_deepening, &threads[started]);
+		if (!threads[started].thread) {
+			LOG_WARNING ("Could only start %u of %u search threads", started, thread_num);
+			break;
+		}
+	}
+	iterative_deepening(&threads[0]);
+	atomic_store_u32(&shared.stop, 1);
+
+	result->nodes = threads[0].nodes;
+	for (i = 1; i < started; ++i) {
+		thread_join(threads[i].thread);
+		result->nodes += threads[i].nodes;
+	}
+	result->time_ns = time_now_ns() - start;
+	mem_free(MEM_SEARCH, threads, thread_num * sizeof (search_context));
+	PROFILE_END(PROFILE_SEARCH);
+	return result;
+}
+
+static void iterative_deepening(void *arg)
+{
+	search_context *s = arg;
+	search_result *result = s->result;
+	u32 depth, max_depth;
+	i32 score;
+
+	max_depth = (s->limits.max_depth && s->limits.max_depth < SEARCH_MAX_PLY) ? s->limits.max_depth : SEARCH_MAX_PLY - 1;
+	// every other helper starts one ply deeper, so the threads do not all search the same tree
+	for (depth = 1 + (s->id & 1); depth <= max_depth; ++depth) {
+		score = alpha_beta(s, (i32) depth, 0, -SCORE_INFINITE, SCORE_INFINITE);
+		if (s->stop)
+			break;
+		if (!result)
+			continue;
+
+		result->depth = depth;
+		result->score = score;
+		result->pv_length = s->pv_length[0];
+		memcpy(result->pv, s->pv[0], s->pv_length[0] * sizeof (move));
+		result->best_move = s->pv[0][0];
+		result->depth_time_ns[depth] = time_now_ns() - s->start;
+		LOG_DEBUG ("depth %u score %d nodes %llu", depth, score, s->nodes);
+
+		// a shorter mate cannot be found by searching deeper
+		if (score >= SCORE_MATE - (i32) depth || score <= -SCORE_MATE + (i32) depth)
+			break;
+	}
+}
+
+static i32 alpha_beta(search_context *s, i32 depth, u32 ply, i32 alpha, i32 beta)
+{
+	move_list moves;
+	i32 scores[MOVE_LIST_CAPACITY];
+	move_undo u;
+	tt_data entry;
+	move m, tt_move = MOVE_NONE, best_move = MOVE_NONE;
+	i32 score, best = -SCORE_INFINITE, alpha_start = alpha;
+	bool check = in_check(&s->state, s->state.active_color);
+	u32 i;
+
+	s->pv_length[ply] = 0;
+	// do not stop in check, the position may be mate
+	if (check)
+		++depth;
+	if (depth <= 0)
+		return quiescence(s, ply, alpha, beta);
+
+	++s->nodes;
+	if (should_stop(s))
+		return 0;
+	if (ply >= SEARCH_MAX_PLY - 1)
+		return evaluate(&s->state);
+	if (ply > 0 && is_draw(s))
+		return 0;
+	if (ply > 0 && probe_bitbase(s, ply, &score))
+		return score;
+
+	if (tt_probe(s->tt, s->state.key, &entry)) {
+		tt_move = entry.best_move;
+		// the root always searches, so the principal variation starts with a move
+		if (ply > 0 && entry.depth >= depth) {
+			score = score_from_tt(entry.score, ply);
+			if (entry.bound == BOUND_EXACT
+				|| (entry.bound == BOUND_LOWER && score >= beta)
+				|| (entry.bound == BOUND_UPPER && score <= alpha))
+			{
+				return score;
+			}
+		}
+	}
+
+	generate_moves(&s->state, &moves);
+	if (!moves.size)
+		return check ? -SCORE_MATE + (i32) ply : 0;
+
+	order_moves(s, &moves, scores, tt_move, ply);
+	for (i = 0; i < moves.size; ++i) {
+		m = pick_move(&moves, scores, i);
+		s->keys[s->key_count++] = s->state.key;
+		make_move(&s->state, m, &u);
+		score = -alpha_beta(s, depth - 1, ply + 1, -beta, -alpha);
+		unmake_move(&s->state, m, &u);
+		--s->key_count;
+		if (s->stop)
+			return 0;
+
+		if (score > best) {
+			best = score;
+			best_move = m;
+			if (score > alpha) {
+				alpha = score;
+				update_pv(s, ply, m);
+				if (alpha >= beta) {
+					if (!move_is_capture(m) && !move_is_promotion(m))
+						update_quiet_stats(s, m, ply, depth);
+					break;
+				}
+			}
+		}
+	}
+
+	tt_store(s->tt, s->state.key, &(tt_data) {
+		best_move, (i16) score_to_tt(best, ply), (u8) depth,
+		best >= beta ? BOUND_LOWER : (best > alpha_start ? BOUND_EXACT : BOUND_UPPER)
+	});
+	return best;
+}
+
+// searches captures and promotions until the position is quiet, or all moves when in check
+static i32 quiescence(search_context *s, u32 ply, i32 alpha, i32 beta)
+{
+	move_list moves;
+	i32 scores[MOVE_LIST_CAPACITY];
+	move_undo u;
+	move m;
+	i32 score, best = -SCORE_INFINITE;
+	bool check = in_check(&s->state, s->state.active_color);
+	u32 i;
+
+	s->pv_length[ply] = 0;
+	++s->nodes;
+	if (should_stop(s))
+		return 0;
+	if (ply >= SEARCH_MAX_PLY - 1)
+		return evaluate(&s->state);
+
+	// without check the side to move may keep the current material instead of capturing
+	if (!check) {
+		best = evaluate(&s->state);
+		if (best >= beta)
+			return best;
+		if (best > alpha)
+			alpha = best;
+	}
+
+	generate_moves(&s->state, &moves);
+	if (!moves.size)
+		return check ? -SCORE_MATE + (i32) ply : 0;
+
+	order_moves(s, &moves, scores, MOVE_NONE, ply);
+	for (i = 0; i < moves.size; ++i) {
+		m = pick_move(&moves, scores, i);
+		// captures are ordered first, the remaining quiet moves are only needed to escape a check
+		if (!check && !move_is_capture(m) && !move_is_promotion(m))
+			break;
+		if (move_is_promotion(m) && move_promotion(m) != QUEEN)
+			continue;
+
+		make_move(&s->state, m, &u);
+		score = -quiescence(s, ply + 1, -beta, -alpha);
+		unmake_move(&s->state, m, &u);
+		if (s->stop)
+			return 0;
+
+		if (score > best) {
+			best = score;
+			if (score > alpha) {
+				alpha = score;
+				update_pv(s, ply, m);
+				if (alpha >= beta)
+					break;
+			}
+		}
+	}
+	return best;
+}
+
+static bool should_stop(search_context *s)
+{
+	u64 total;
+
+	if (s->stop || s->nodes % STOP_CHECK_INTERVAL)
+		return s->stop;
+
+	total = atomic_add_u64(&s->shared->nodes, s->nodes - s->nodes_reported);
+	s->nodes_reported = s->nodes;
+	if (atomic_load_u32(&s->shared->stop)
+		|| (s->limits.stop && atomic_load_u32(s->limits.stop))
+		|| (s->limits.node_limit && total >= s->limits.node_limit)
+		|| (s->deadline && time_now_ns() >= s->deadline))
+	{
+		s->stop = true;
+	}
+	return s->stop;
+}
+
+// fifty-move rule or a repetition of any earlier position, searching on from a repetition only repeats the same tree
+static bool is_draw(const search_context *s)
+{
+	u32 i;
+
+	if (s->state.halfmove_clock >= FIFTY_MOVE_PLIES)
+		return true;
+	// positions before the last irreversible move differ, and only every other one has the same side to move
+	for (i = 4; i <= s->state.halfmove_clock && i <= s->key_count; i += 2) {
+		if (s->keys[s->key_count - i] == s->state.key)
+			return true;
+	}
+	return false;
+}
+
+// every position after a won one would score the same, so wins are only used when the root is not covered and the search makes progress
+static bool probe_bitbase(const search_context *s, u32 ply, i32 *score)
+{
+	piece_color winner;
+
+	switch (bitbase_probe(&s->state, &winner)) {
+	case BITBASE_DRAW:
+		*score = 0;
+		return true;
+	case BITBASE_WIN:
+		*score = (winner == s->state.active_color) ? SCORE_KNOWN_WIN - (i32) ply : -SCORE_KNOWN_WIN + (i32) ply;
+		return !s->is_root_known;
+	default:
+		return false;
+	}
+}
+
+// TT move first, then captures by most valuable victim and least valuable attacker, killers and quiet moves by history
+static void order_moves(const search_context *s, const move_list *moves, i32 *scores, move tt_move, u32 ply)
+{
+	piece_color color = s->state.active_color;
+	piece_color enemy = (color == WHITE) ? BLACK : WHITE;
+	piece_type victim;
+	move m;
+	u32 i;
+
+	for (i = 0; i < moves->size; ++i) {
+		m = moves->moves[i];
+		if (m == tt_move) {
+			scores[i] = ORDER_TT_MOVE;
+		} else if (move_is_capture(m) || move_is_promotion(m)) {
+			victim = (move_flags(m) == MOVE_EN_PESSANT) ? PAWN : piece_type_at(&s->state, move_to(m), enemy);
+			scores[i] = ORDER_CAPTURE
+				+ (victim != PIECE_TYPE_MAX ? piece_values[victim] * 16 : 0)
+				+ (move_is_promotion(m) ? piece_values[move_promotion(m)] * 16 : 0)
+				- piece_values[piece_type_at(&s->state, move_from(m), color)] / 16;
+		} else if (m == s->killers[ply][0]) {
+			scores[i] = ORDER_KILLER + 1;
+		} else if (m == s->killers[ply][1]) {
+			scores[i] = ORDER_KILLER;
+		} else {
+			scores[i] = s->history[color][move_from(m)][move_to(m)];
+		}
+	}
+}
+
+// moves the best remaining move to position i and returns it
+static move pick_move(move_list *moves, i32 *scores, u32 i)
+{
+	u32 j, best = i;
+	move m;
+	i32 score;
+
+	for (j = i + 1; j < moves->size; ++j) {
+		if (scores[j] > scores[best])
+			best = j;
+	}
+	m = moves->moves[best];
+	moves->moves[best] = moves->moves[i];
+	moves->moves[i] = m;
+	score = scores[best];
+	scores[best] = scores[i];
+	scores[i] = score;
+	return m;
+}
+
+static void update_pv(search_context *s, u32 ply, move m)
+{
+	s->pv[ply][0] = m;
+	memcpy(&s->pv[ply][1], s->pv[ply + 1], s->pv_length[ply + 1] * sizeof (move));
+	s->pv_length[ply] = s->pv_length[ply + 1] + 1;
+}
+
+static void update_quiet_stats(search_context *s, move m, u32 ply, i32 depth)
+{
+	i32 *h = &s->history[s->state.active_color][move_from(m)][move_to(m)];
+	u32 from, to;
+	piece_color color;
+
+	if (s->killers[ply][0] != m) {
+		s->killers[ply][1] = s->killers[ply][0];
+		s->killers[ply][0] = m;
+	}
+
+	*h += depth * depth;
+	// keep history below the killers, halving keeps the relative order
+	if (*h >= HISTORY_MAX) {
+		for (color = 0; color < COLOR_MAX; ++color) {
+			for (from = 0; from < SQUARE_NUM; ++from) {
+				for (to = 0; to < SQUARE_NUM; ++to)
+					s->history[color][from][to] /= 2;
+			}
+		}
+	}
+}
+
+// mate and known win scores are stored relative to the position instead of the root
+static i32 score_to_tt(i32 score, u32 ply)
+{
+	if (score > SCORE_KNOWN_WIN_BOUND)
+		return score + (i32) ply;
+	if (score < -SCORE_KNOWN_WIN_BOUND)
+		return score - (i32) ply;
+	return score;
+}
+
+static i32 score_from_tt(i32 score, u32 ply)
+{
+	if (score > SCORE_KNOWN_WIN_BOUND)
+		return score - (i32) ply;
+	if (score < -SCORE_KNOWN_WIN_BOUND)
+		return score + (i32) ply;
+	return score;
+}
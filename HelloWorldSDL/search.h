@@ -0,0 +1,64 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "chess.h"
+#include "tt.h"
+#include "types.h"
+
+#define SEARCH_MAX_PLY 64
+#define SCORE_INFINITE 32000
+#define SCORE_MATE 31000 /* score of being mated at the root, mate in n plies scores SCORE_MATE - n */
+#define SCORE_MATE_BOUND (SCORE_MATE - SEARCH_MAX_PLY) /* scores beyond this are mate scores */
+#define SCORE_KNOWN_WIN 20000 /* bitbase win n plies from the root scores SCORE_KNOWN_WIN - n */
+#define SCORE_KNOWN_WIN_BOUND (SCORE_KNOWN_WIN - SEARCH_MAX_PLY) /* scores beyond this depend on the ply, like mate scores */
+
+/// <summary>
+/// When to stop searching. The search stops at whichever limit is reached first.
+/// </summary>
+typedef struct {
+	u32 max_depth; /* deepest iteration, 0 for no limit */
+	u64 time_limit_ns; /* thinking time, 0 for no limit */
+	u64 node_limit; /* nodes to visit, 0 for no limit */
+	const volatile u32 *stop; /* another thread stops the search by setting it to 1, may be NULL */
+} search_limits;
+
+/// <summary>
+/// Outcome of the last completed iteration
+/// </summary>
+typedef struct {
+	move best_move; /* MOVE_NONE if the side to move has no legal move */
+	i32 score; /* centipawns from the view of the side to move */
+	u32 depth; /* depth of the last completed iteration */
+	u64 nodes; /* nodes visited in all iterations by all threads */
+	u64 time_ns; /* time spent */
+	u64 depth_time_ns[SEARCH_MAX_PLY]; /* time at which each iteration was completed, 0 if it was not */
+	move pv[SEARCH_MAX_PLY]; /* principal variation, starting with best_move */
+	u32 pv_length;
+} search_result;
+
+/// <summary>
+/// Find the best move with an iteratively deepened alpha-beta search
+/// </summary>
+/// <param name="c">position to search, not modified</param>
+/// <param name="history">positions of the game leading to c for repetition detection, may be NULL</param>
+/// <param name="tt">transposition table shared with earlier searches</param>
+/// <param name="limits">when to stop</param>
+/// <param name="result">receives best move, score and principal variation</param>
+/// <returns>result</returns>
+search_result *search(const chess_state *c, const position_history *history, transposition_table *tt, const search_limits *limits, search_result *result);
+
+/// <summary>
+/// Search with thread_num threads (Lazy SMP). All threads search the same position and share
+/// what they found only through tt. The calling thread is the main thread: its last completed
+/// iteration is the result, and the helpers stop as soon as it is done.
+/// </summary>
+/// <param name="c">position to search, not modified</param>
+/// <param name="history">positions of the game leading to c for repetition detection, may be NULL</param>
+/// <param name="tt">transposition table shared by all threads</param>
+/// <param name="limits">when to stop, the node limit counts the nodes of all threads</param>
+/// <param name="thread_num">number of threads including the calling thread</param>
+/// <param name="result">receives best move, score and principal variation</param>
+/// <returns>result</returns>
+search_result *search_parallel(const chess_state *c, const position_history *history, transposition_table *tt, const search_limits *limits, u32 thread_num, search_result *result);
+
+#endif
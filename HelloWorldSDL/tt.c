@@ -0,0 +1,125 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "mem.h"
+#include "tt.h"
+
+// depth an entry loses for every search it is old when choosing which one to replace
+#define TT_AGE_PENALTY 8
+
+static u64 pack(const tt_data *data, u8 generation);
+static void unpack(u64 packed, tt_data *data);
+static u8 entry_generation(u64 packed);
+
+bool tt_init(transposition_table *tt, u64 size_mb)
+{
+	u64 buckets = 1;
+
+	ASSERT_ERROR (tt, "Argument tt was NULL");
+
+	while (buckets * 2 * TT_BUCKET_SIZE * sizeof (tt_entry) <= size_mb * 1024 * 1024)
+		buckets *= 2;
+
+	// malloc only aligns to 16 bytes, so the table is allocated with room to align it
+	tt->memory = mem_calloc(MEM_TT, buckets * TT_BUCKET_SIZE * sizeof (tt_entry) + TT_ALIGNMENT, 1);
+	if (!tt->memory) {
+		tt->entries = NULL;
+		LOG_WARNING ("Could not allocate a transposition table of %llu MiB", size_mb);
+		return false;
+	}
+	tt->entries = (tt_entry *) (((uintptr_t) tt->memory + TT_ALIGNMENT - 1) & ~(uintptr_t) (TT_ALIGNMENT - 1));
+	tt->mask = buckets - 1;
+	tt->generation = 0;
+	return true;
+}
+
+void tt_free(transposition_table *tt)
+{
+	mem_free(MEM_TT, tt->memory, (tt->mask + 1) * TT_BUCKET_SIZE * sizeof (tt_entry) + TT_ALIGNMENT);
+	tt->memory = NULL;
+	tt->entries = NULL;
+	tt->mask = 0;
+}
+
+void tt_clear(transposition_table *tt)
+{
+	memset(tt->entries, 0, (tt->mask + 1) * TT_BUCKET_SIZE * sizeof (tt_entry));
+	tt->generation = 0;
+}
+
+void tt_new_search(transposition_table *tt)
+{
+	++tt->generation;
+}
+
+bool tt_probe(const transposition_table *tt, u64 key, tt_data *data)
+{
+	const volatile tt_entry *bucket = &tt->entries[(key & tt->mask) * TT_BUCKET_SIZE];
+	u64 entry_data;
+	u32 i;
+
+	for (i = 0; i < TT_BUCKET_SIZE; ++i) {
+		// read once, another thread may write the entry meanwhile
+		entry_data = bucket[i].data;
+		if ((bucket[i].key ^ entry_data) == key && entry_data) {
+			unpack(entry_data, data);
+			return true;
+		}
+	}
+	return false;
+}
+
+void tt_store(transposition_table *tt, u64 key, const tt_data *data)
+{
+	volatile tt_entry *bucket = &tt->entries[(key & tt->mask) * TT_BUCKET_SIZE];
+	volatile tt_entry *replace = &bucket[0];
+	tt_data old;
+	u64 entry_data, new_data = pack(data, tt->generation);
+	i32 value, lowest = INT32_MAX;
+	u32 i;
+
+	for (i = 0; i < TT_BUCKET_SIZE; ++i) {
+		entry_data = bucket[i].data;
+		unpack(entry_data, &old);
+		if ((bucket[i].key ^ entry_data) == key) {
+			replace = &bucket[i];
+			// a shallower result without a move must not throw away the known best move
+			if (data->best_move == MOVE_NONE && old.best_move != MOVE_NONE)
+				new_data = pack(&(tt_data) { old.best_move, data->score, data->depth, data->bound }, tt->generation);
+			break;
+		}
+		value = old.depth - TT_AGE_PENALTY * (u8) (tt->generation - entry_generation(entry_data));
+		if (value < lowest) {
+			lowest = value;
+			replace = &bucket[i];
+		}
+	}
+
+	// a torn entry mixing two writes fails the key check in tt_probe
+	replace->key = key ^ new_data;
+	replace->data = new_data;
+}
+
+static u64 pack(const tt_data *data, u8 generation)
+{
+	return (u64) data->best_move
+		| (u64) (u16) data->score << 16
+		| (u64) data->depth << 32
+		| (u64) data->bound << 40
+		| (u64) generation << 48;
+}
+
+static void unpack(u64 packed, tt_data *data)
+{
+	data->best_move = (move) packed;
+	data->score = (i16) (u16) (packed >> 16);
+	data->depth = (u8) (packed >> 32);
+	data->bound = (tt_bound) ((packed >> 40) & 3);
+}
+
+static u8 entry_generation(u64 packed)
+{
+	return (u8) (packed >> 48);
+}
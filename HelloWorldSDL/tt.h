@@ -0,0 +1,91 @@
+#ifndef TT_H
+#define TT_H
+
+#include "chess.h"
+#include "types.h"
+
+#define TT_BUCKET_SIZE 4 /* entries sharing one 64 byte cache line */
+#define TT_ALIGNMENT 64 /* bucket alignment, so a probe touches a single cache line */
+#define TT_DEFAULT_SIZE_MB 64
+
+typedef enum {
+	BOUND_NONE,
+	BOUND_UPPER, /* score is at most the stored value (fail low) */
+	BOUND_LOWER, /* score is at least the stored value (fail high) */
+	BOUND_EXACT
+} tt_bound;
+
+/// <summary>
+/// 16 byte table entry. data packs the fields of tt_data: bits 0-15 best move, 16-31 score,
+/// 32-39 depth, 40-41 bound, 48-55 generation of the search which stored it.
+/// Threads share the table without locks. key holds the position key XOR data, so an entry
+/// whose two halves were written by different threads does not match any position.
+/// </summary>
+typedef struct {
+	u64 key; /* Zobrist key ^ data */
+	u64 data;
+} tt_entry;
+
+/// <summary>
+/// Unpacked contents of an entry
+/// </summary>
+typedef struct {
+	move best_move; /* MOVE_NONE if unknown */
+	i16 score;
+	u8 depth; /* remaining depth the score was searched with */
+	tt_bound bound;
+} tt_data;
+
+/// <summary>
+/// Hash table of search results, indexed by the Zobrist key of the position.
+/// The number of entries is a power of two, so the index is a mask of the key.
+/// </summary>
+typedef struct {
+	tt_entry *entries; /* TT_ALIGNMENT aligned within memory */
+	void *memory; /* allocation holding the entries */
+	u64 mask; /* number of buckets - 1 */
+	u8 generation; /* incremented for every new search, entries of older searches are replaced first */
+} transposition_table;
+
+/// <summary>
+/// Allocate an empty table
+/// </summary>
+/// <param name="tt">table to initialize</param>
+/// <param name="size_mb">memory to use in MiB, rounded down to a power of two and at least one bucket</param>
+/// <returns>false if the memory could not be allocated</returns>
+bool tt_init(transposition_table *tt, u64 size_mb);
+
+/// <summary>
+/// Release the memory of the table
+/// </summary>
+void tt_free(transposition_table *tt);
+
+/// <summary>
+/// Remove all entries
+/// </summary>
+void tt_clear(transposition_table *tt);
+
+/// <summary>
+/// Start a new search, entries stored from now on are preferred over older ones
+/// </summary>
+void tt_new_search(transposition_table *tt);
+
+/// <summary>
+/// Look up a position
+/// </summary>
+/// <param name="tt">table</param>
+/// <param name="key">Zobrist key of the position</param>
+/// <param name="data">receives the entry if found</param>
+/// <returns>true if the position was found</returns>
+bool tt_probe(const transposition_table *tt, u64 key, tt_data *data);
+
+/// <summary>
+/// Store a search result. Within the bucket the entry of the same position is overwritten,
+/// else the entry with the lowest depth, entries of older searches counting as shallower.
+/// </summary>
+/// <param name="tt">table</param>
+/// <param name="key">Zobrist key of the position</param>
+/// <param name="data">result to store</param>
+void tt_store(transposition_table *tt, u64 key, const tt_data *data);
+
+#endif
@@ -1,10 +1,15 @@
 #include <stdlib.h>
+#include <string.h>
 
 #include "utils.h"
 #include "log.h"
+#include "mem.h"
 #include "types.h"
 
-static dllist_elem *create_elem(const dllist *list, const void *data, dllist_elem *prev, dllist_elem *next);
+static dllist *insert_head(dllist *list, const void *data, bool owned);
+static dllist *insert_tail(dllist *list, const void *data, bool owned);
+static dllist_elem *create_elem(const dllist *list, const void *data, bool owned, dllist_elem *prev, dllist_elem *next);
+static void free_elem(const dllist *list, dllist_elem *e);
 
 dllist *ddlist_init(dllist *list, void *(*clone_data) (const void *), void (*free_data) (void *))
 {
@@ -27,6 +32,7 @@ dllist *dllist_concat(dllist *front, dllist *end)
 		ASSERT_ERROR (!front->tail, "No head but tail!");
 		front->head = end->head;
 		front->tail = end->tail;
+		front->size = end->size;
 	} else {
 		ASSERT_ERROR (!front->tail->next, "front->tail->next is not NULL!");
 		ASSERT_ERROR (!front->head->prev, "front->head->prev is not NULL!");
@@ -35,14 +41,36 @@ dllist *dllist_concat(dllist *front, dllist *end)
 		front->tail->next = end->head;
 		end->head->prev = front->tail;
 		front->tail = end->tail;
+		front->size += end->size;
 	}
 EXIT:
 	end->head = NULL;
 	end->tail = NULL;
+	end->size = 0;
 	return front;
 }
 
 dllist *dllist_insert_head(dllist *list, const void *data)
+{
+	return insert_head(list, data, false);
+}
+
+dllist *dllist_insert_tail(dllist *list, const void *data)
+{
+	return insert_tail(list, data, false);
+}
+
+dllist *dllist_insert_head_owned(dllist *list, void *data)
+{
+	return insert_head(list, data, true);
+}
+
+dllist *dllist_insert_tail_owned(dllist *list, void *data)
+{
+	return insert_tail(list, data, true);
+}
+
+static dllist *insert_head(dllist *list, const void *data, bool owned)
 {
 	dllist_elem *tmp;
 
@@ -54,21 +82,23 @@ dllist *dllist_insert_head(dllist *list, const void *data)
 	if (!list->head) {
 		ASSERT_ERROR (!list->tail, "No head but tail!");
 
-		list->head = create_elem(list, data, NULL, NULL);
+		list->head = create_elem(list, data, owned, NULL, NULL);
 		list->tail = list->head;
+		list->size = 1;
 
 		return list;
 	}
 
 	tmp = list->head;
 	//LOG_DEBUG ("Creating new list element %llu to list %p", dllist_size(list), list);
-	list->head = create_elem(list, data, NULL, tmp);
+	list->head = create_elem(list, data, owned, NULL, tmp);
 	tmp->prev = list->head;
+	++list->size;
 
 	return list;
 }
 
-dllist * dllist_insert_tail(dllist *list, const void *data)
+static dllist *insert_tail(dllist *list, const void *data, bool owned)
 {
 	dllist_elem *tmp;
 
@@ -77,15 +107,15 @@ dllist * dllist_insert_tail(dllist *list, const void *data)
 
 	ASSERT_ERROR (list, "Argument list is NULL!");
 
-	if (!list->head) {
-		dllist_insert_head(list, data);
-	}
+	if (!list->head)
+		return insert_head(list, data, owned);
 
 	tmp = list->tail;
 	//LOG_DEBUG ("Creating new list element %llu to list %p", dllist_size(list), list);
-	list->tail = create_elem(list, data, tmp, NULL);
+	list->tail = create_elem(list, data, owned, tmp, NULL);
 	ASSERT_ERROR (list->tail, "calloc returned NULL!");
 	tmp->next = list->tail;
+	++list->size;
 
 	return list;
 }
@@ -100,11 +130,11 @@ void dllist_clear_elems(dllist *list)
 	while (list->head) {
 		tmp = list->head;
 		list->head = list->head->next;
-		list->free_data(tmp->data);
-		free(tmp);
+		free_elem(list, tmp);
 	}
 	list->head = NULL;
 	list->tail = NULL;
+	list->size = 0;
 }
 
 dllist * dllist_filter(dllist *list, bool (filter_fn (void *data)))
@@ -137,8 +167,8 @@ dllist * dllist_filter(dllist *list, bool (filter_fn (void *data)))
 
 			tmp = iter;
 			iter = iter->next;
-			list->free_data(tmp->data);
-			free(tmp);
+			free_elem(list, tmp);
+			--list->size;
 		} else {
 			iter = iter->next;
 		}
@@ -159,12 +189,7 @@ bool dllist_exists(const dllist *list, bool (exists_fn (const void *data)))
 
 u64 dllist_size(const dllist *list)
 {
-	dllist_elem *iter;
-	u64 size = 0;
-	for (iter = list->head; iter; iter = iter->next) {
-		size++;
-	}
-	return size;
+	return list->size;
 }
 
 dllist *dllist_init(dllist *list, void *(*clone_data) (const void *), void (*free_data) (void *))
@@ -174,10 +199,42 @@ dllist *dllist_init(dllist *list, void *(*clone_data) (const void *), void (*fre
 	list->free_data = free_data;
 	list->head = NULL;
 	list->tail = NULL;
+	list->size = 0;
+	list->allocator = NULL;
+	list->data_size = 0;
 	
 	return list;
 }
 
+dllist *dllist_init_allocator(dllist *list, size_t data_size, dllist_allocator *allocator)
+{
+	ASSERT_ERROR (allocator, "Argument allocator is NULL!");
+	dllist_init(list, NULL, NULL);
+	list->allocator = allocator;
+	list->data_size = data_size;
+	return list;
+}
+
+dllist_allocator *dllist_allocator_init(dllist_allocator *a)
+{
+	ASSERT_ERROR (a, "Argument a is NULL!");
+	arena_init(&a->memory, 0);
+	pool_init(&a->elems, &a->memory, sizeof (dllist_elem));
+	return a;
+}
+
+void dllist_allocator_reset(dllist_allocator *a)
+{
+	arena_reset(&a->memory);
+	pool_reset(&a->elems);
+}
+
+void dllist_allocator_free(dllist_allocator *a)
+{
+	arena_free(&a->memory);
+	pool_reset(&a->elems);
+}
+
 dllist *dllist_apply(dllist *list, void (*apply) (void *))
 {
 	dllist_elem *iter;
@@ -194,23 +251,139 @@ dllist *dllist_duplicate(const dllist *list)
 	dllist_elem *list_iter;
 	duplicate->clone_data = list->clone_data;
 	duplicate->free_data = list->free_data;
+	duplicate->allocator = list->allocator;
+	duplicate->data_size = list->data_size;
 
+	// inserting clones the data already
 	for (list_iter = list->head; list_iter != NULL; list_iter = list_iter->next) {
-		dllist_insert_head(duplicate, duplicate->clone_data(list_iter->data));
+		dllist_insert_tail(duplicate, list_iter->data);
 	}
 	
 	return duplicate;
 }
 
-static dllist_elem *create_elem(const dllist *list, const void *data, dllist_elem *prev, dllist_elem *next)
+vector *vector_init(vector *v, size_t elem_size)
+{
+	ASSERT_ERROR (v, "Argument v is NULL!");
+	v->data = NULL;
+	v->size = 0;
+	v->capacity = 0;
+	v->elem_size = elem_size;
+	v->subsystem = MEM_CONTAINERS;
+	return v;
+}
+
+void vector_free(vector *v)
+{
+	mem_free(v->subsystem, v->data, v->capacity * v->elem_size);
+	v->data = NULL;
+	v->size = 0;
+	v->capacity = 0;
+}
+
+void *vector_push(vector *v, const void *elem)
+{
+	vector_resize(v, v->size + 1);
+	return memcpy(vector_at(v, v->size - 1), elem, v->elem_size);
+}
+
+vector *vector_resize(vector *v, u64 size)
+{
+	u64 capacity = v->capacity ? v->capacity : 16;
+
+	if (size > v->capacity) {
+		while (capacity < size)
+			capacity *= 2;
+		v->data = mem_realloc(v->subsystem, v->data, v->capacity * v->elem_size, capacity * v->elem_size);
+		ASSERT_ERROR (v->data, "realloc returned NULL!");
+		v->capacity = capacity;
+	}
+	v->size = size;
+	return v;
+}
+
+// moves the kept elements to the front in one pass
+vector *vector_filter(vector *v, bool (filter_fn (void *data)))
+{
+	u64 i, kept = 0;
+
+	for (i = 0; i < v->size; ++i) {
+		if (!filter_fn(vector_at(v, i)))
+			continue;
+		if (kept != i)
+			memcpy(vector_at(v, kept), vector_at(v, i), v->elem_size);
+		++kept;
+	}
+	v->size = kept;
+	return v;
+}
+
+bool vector_exists(const vector *v, bool (exists_fn (const void *data)))
+{
+	u64 i;
+	for (i = 0; i < v->size; ++i) {
+		if (exists_fn(vector_at(v, i)))
+			return true;
+	}
+	return false;
+}
+
+u64 vector_size(const vector *v)
+{
+	return v->size;
+}
+
+vector *vector_apply(vector *v, void (*apply) (void *))
+{
+	u64 i;
+	for (i = 0; i < v->size; ++i)
+		apply(vector_at(v, i));
+	return v;
+}
+
+vector *vector_duplicate(const vector *v)
+{
+	vector *duplicate = calloc(1, sizeof (vector));
+	ASSERT_ERROR (duplicate, "calloc returned NULL!");
+
+	vector_init(duplicate, v->elem_size);
+	duplicate->subsystem = v->subsystem;
+	if (v->size) {
+		vector_resize(duplicate, v->size);
+		memcpy(duplicate->data, v->data, v->size * v->elem_size);
+	}
+	return duplicate;
+}
+
+// owned data is stored as it is and freed with the element
+static dllist_elem *create_elem(const dllist *list, const void *data, bool owned, dllist_elem *prev, dllist_elem *next)
 {
 	ASSERT_ERROR (list && data, "Argument list or data is NULL!");
 
-	dllist_elem *e = calloc(1, sizeof (dllist_elem));
-	ASSERT_ERROR (e, "Creating first list_elem: calloc failed!");
+	dllist_elem *e;
+
+	if (list->allocator) {
+		ASSERT_ERROR (!owned, "Lists in an allocator copy their payloads!");
+		e = pool_alloc(&list->allocator->elems);
+		e->data = memcpy(arena_alloc(&list->allocator->memory, list->data_size), data, list->data_size);
+	} else {
+		e = mem_calloc(MEM_CONTAINERS, 1, sizeof (dllist_elem));
+		ASSERT_ERROR (e, "Creating first list_elem: calloc failed!");
+		e->data = owned ? (void *) data : list->clone_data(data);
+	}
 	e->next = next;
 	e->prev = prev;
-	e->data = list->clone_data(data);
 
 	return e;
+}
+
+// payloads in an allocator stay until it is reset, only the node is reused
+static void free_elem(const dllist *list, dllist_elem *e)
+{
+	if (list->allocator) {
+		pool_release(&list->allocator->elems, e);
+		return;
+	}
+	list->free_data(e->data);
+	mem_free(MEM_CONTAINERS, e, sizeof (dllist_elem));
 }
\ No newline at end of file
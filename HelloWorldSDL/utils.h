@@ -2,9 +2,21 @@
 #define UTILS_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
+#include "arena.h"
+#include "mem.h"
 #include "types.h"
 
+/// <summary>
+/// Memory shared by lists whose elements are all released at the same time,
+/// e.g. the lists built for one position or one search
+/// </summary>
+typedef struct {
+	arena memory; /* list nodes and copies of the payloads */
+	pool elems; /* dllist_elem nodes, reused after dllist_filter and dllist_clear_elems */
+} dllist_allocator;
+
 typedef struct dllist_elem {
 	void *data;
 	struct dllist_elem *next;
@@ -14,14 +26,56 @@ typedef struct dllist_elem {
 typedef struct dllist {
 	dllist_elem *head;
 	dllist_elem *tail;
+	u64 size; /* number of elements */
 
 	void *(*clone_data) (const void *);
 	void (*free_data) (void *);
+	dllist_allocator *allocator; /* NULL if elements and payloads are allocated with malloc */
+	size_t data_size; /* payload bytes copied into the allocator instead of calling clone_data */
 } dllist;
 
 dllist *dllist_init(dllist *list, void *(*clone_data) (const void *), void (*free_data) (void *));
 
-dllist *dllist_insert_tail(dllist *list, void *data);
+/// <summary>
+/// Initialize an empty list which takes its nodes and payload copies from an allocator.
+/// Payloads are copied byte by byte and not freed individually.
+/// </summary>
+/// <param name="list">list to initialize</param>
+/// <param name="data_size">bytes of one payload</param>
+/// <param name="allocator">allocator, has to outlive the list</param>
+/// <returns>list</returns>
+dllist *dllist_init_allocator(dllist *list, size_t data_size, dllist_allocator *allocator);
+
+/// <summary>
+/// Initialize an allocator for lists
+/// </summary>
+/// <param name="a">allocator to initialize</param>
+/// <returns>a</returns>
+dllist_allocator *dllist_allocator_init(dllist_allocator *a);
+
+/// <summary>
+/// Release all elements of all lists using the allocator in constant time.
+/// The lists have to be initialized again before they are used.
+/// </summary>
+/// <param name="a">allocator</param>
+void dllist_allocator_reset(dllist_allocator *a);
+
+/// <summary>
+/// Return the memory of the allocator to the system
+/// </summary>
+/// <param name="a">allocator</param>
+void dllist_allocator_free(dllist_allocator *a);
+
+dllist *dllist_insert_tail(dllist *list, const void *data);
+
+/// <summary>
+/// Append data without cloning it. The list frees it with free_data when the element is removed.
+/// Not for lists in an allocator, which copy their payloads.
+/// </summary>
+/// <param name="list">list to append to</param>
+/// <param name="data">payload, owned by the list afterwards</param>
+/// <returns>list</returns>
+dllist *dllist_insert_tail_owned(dllist *list, void *data);
 
 void dllist_clear_elems(dllist *list);
 
@@ -33,10 +87,79 @@ u64 dllist_size(const dllist *list);
 
 dllist *dllist_concat(dllist *front, dllist *end);
 
-dllist *dllist_insert_head(dllist *list, void *data);
+dllist *dllist_insert_head(dllist *list, const void *data);
+
+/// <summary>
+/// Prepend data without cloning it, see dllist_insert_tail_owned
+/// </summary>
+dllist *dllist_insert_head_owned(dllist *list, void *data);
 
 dllist *dllist_apply(dllist *list, void (*apply) (void *));
 
 dllist *dllist_duplicate(const dllist *list);
 
+/// <summary>
+/// Growable array of equally sized elements. Iterating it touches contiguous memory
+/// instead of one node per element, so prefer it to dllist unless elements are
+/// inserted at the front or lists are concatenated.
+/// </summary>
+typedef struct {
+	void *data; /* size elements, NULL until the first one is added */
+	u64 size; /* number of elements */
+	u64 capacity; /* number of elements data has room for */
+	size_t elem_size; /* bytes per element */
+	mem_subsystem subsystem; /* the elements are accounted to, MEM_CONTAINERS unless changed after vector_init */
+} vector;
+
+/// <summary>
+/// Initialize an empty vector, no memory is allocated before the first element is added
+/// </summary>
+/// <param name="v">vector to initialize</param>
+/// <param name="elem_size">bytes per element</param>
+/// <returns>v</returns>
+vector *vector_init(vector *v, size_t elem_size);
+
+/// <summary>
+/// Release the elements, v is empty afterwards
+/// </summary>
+/// <param name="v">vector</param>
+void vector_free(vector *v);
+
+/// <summary>
+/// Append a copy of an element. Pointers to elements are invalidated if the vector has to grow.
+/// </summary>
+/// <param name="v">vector</param>
+/// <param name="elem">elem_size bytes to copy</param>
+/// <returns>pointer to the copy in the vector</returns>
+void *vector_push(vector *v, const void *elem);
+
+/// <summary>
+/// Change the number of elements. New elements are uninitialized.
+/// </summary>
+/// <param name="v">vector</param>
+/// <param name="size">new number of elements</param>
+/// <returns>v</returns>
+vector *vector_resize(vector *v, u64 size);
+
+/// <summary>
+/// Remove all elements for which filter_fn returns false, keeping the order of the others
+/// </summary>
+vector *vector_filter(vector *v, bool (filter_fn (void *data)));
+
+bool vector_exists(const vector *v, bool (exists_fn (const void *data)));
+
+u64 vector_size(const vector *v);
+
+vector *vector_apply(vector *v, void (*apply) (void *));
+
+vector *vector_duplicate(const vector *v);
+
+/// <summary>
+/// Element i of the vector, i has to be less than its size
+/// </summary>
+static inline void *vector_at(const vector *v, u64 i)
+{
+	return (char *) v->data + i * v->elem_size;
+}
+
 #endif
\ No newline at end of file
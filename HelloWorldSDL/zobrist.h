@@ -0,0 +1,25 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include "bitboard.h"
+#include "chess.h"
+#include "types.h"
+
+/// <summary>
+/// Random keys, one per piece on a square, castling right, en pessant file and for black to move.
+/// The key of a position is the XOR of the keys of everything present in it.
+/// </summary>
+extern const u64 zobrist_pieces[COLOR_MAX][PIECE_TYPE_MAX][SQUARE_NUM];
+extern const u64 zobrist_castle[DIRECTION_MAX][COLOR_MAX];
+extern const u64 zobrist_en_pessant[BOARD_SIDE_LENGTH];
+extern const u64 zobrist_black_to_move;
+
+/// <summary>
+/// Compute the Zobrist key of a game state from scratch. make_move keeps chess_state.key up to date,
+/// so this is only needed when a state is built by other means.
+/// </summary>
+/// <param name="c">game state</param>
+/// <returns>64 bit key of c</returns>
+u64 zobrist_key(const chess_state *c);
+
+#endif
@@ -0,0 +1,412 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "attacks.h"
+#include "bitbase.h"
+#include "book.h"
+#include "chess.h"
+#include "epd.h"
+#include "log.h"
+#include "perft.h"
+#include "pgn.h"
+#include "platform.h"
+#include "profile.h"
+#include "search.h"
+#include "tt.h"
+
+#define DEFAULT_DEPTH 4
+#define DEFAULT_SEARCH_DEPTH 8
+#define DEFAULT_MOVE_TIME_MS 100 /* thinking time per move of a match without -d or -movetime */
+#define DEFAULT_BOOK_PLIES 16 /* plies of every game added to a book by -makebook without -d */
+#define MATCH_MAX_PLIES 400 /* match games are drawn after this many plies */
+
+typedef struct {
+	u32 depth;
+	u32 thread_num;
+	const char *fen; /* NULL runs the reference positions */
+	const char *epd; /* suite file run instead of the reference positions, NULL for none */
+	u64 move_time_ms; /* search time per suite position, 0 for no limit */
+	const char *pgn; /* game collection replayed instead of the reference positions, NULL for none */
+	const char *book; /* opening book for -match, or the book created by -makebook */
+	u32 match_games; /* games the engine plays against itself, 0 for no match */
+	bool divide;
+	bool quiet; /* only the total is printed */
+	bool search; /* benchmark the search instead of perft */
+	u64 hash_mb; /* transposition table size for the search */
+} perft_options;
+
+static void print_usage(const char *name)
+{
+	printf("Usage: %s [-d depth] [-f fen] [-t threads] [-divide] [-scaling] [-search] [-hash MB] [-nopext] [-profile file]\n", name);
+	printf("       %s -epd file [-d depth] [-t threads] [-search] [-movetime ms] [-hash MB]\n", name);
+	printf("       %s -pgn file [-t threads] [-makebook book] [-d plies]\n", name);
+	printf("       %s -match games [-book file] [-d depth] [-movetime ms] [-t threads] [-hash MB]\n", name);
+	printf("  -d depth    perft depth in plies (default %u, %u with -search)\n", DEFAULT_DEPTH, DEFAULT_SEARCH_DEPTH);
+	printf("  -f fen      count this position instead of the reference positions\n");
+	printf("  -t threads  number of worker threads (default 1)\n");
+	printf("  -divide     print the node count below each root move\n");
+	printf("  -scaling    repeat the run with 1, 2, 4, ... up to %u threads and report the efficiency\n", cpu_count());
+	printf("  -search     run a fixed depth search on each position and report the time to each depth\n");
+	printf("  -hash MB    transposition table size for -search (default %u), per thread with -epd\n", TT_DEFAULT_SIZE_MB);
+	printf("  -epd file   check the perft counts (D1, D2, ...) of each position in an EPD suite, positions are spread over\n");
+	printf("              the threads; -d limits the depth; with -search the best moves (bm, am) are checked instead\n");
+	printf("  -movetime   search time per position in milliseconds for -epd -search\n");
+	printf("  -pgn file   replay all games of a PGN file and report illegal moves and wrong results\n");
+	printf("  -makebook   write a Polyglot opening book with the first plies (default %u) of the replayed games\n", DEFAULT_BOOK_PLIES);
+	printf("  -match n    play n games of the engine against itself, %u ms per move unless -d or -movetime is given\n", DEFAULT_MOVE_TIME_MS);
+	printf("  -book file  Polyglot opening book choosing the first moves of the match games\n");
+	printf("  -nopext     look up slider attacks with magic multiplication even if PEXT is available\n");
+	printf("  -profile f  print the performance counters as JSON and write the timer events to trace file f,\n");
+	printf("              needs a build with PROFILE defined\n");
+}
+
+// next thread count of a scaling run, 0 after the processor count
+static u32 next_thread_num(u32 thread_num)
+{
+	u32 max_threads = cpu_count();
+
+	if (thread_num >= max_threads)
+		return 0;
+	return thread_num * 2 < max_threads ? thread_num * 2 : max_threads;
+}
+
+// runs perft on one position, prints the result and returns the number of counted nodes
+static u64 run_position(const perft_options *o, const char *name, const char *fen, u64 expected, bool *failed, u64 *time_ns)
+{
+	chess_state c;
+	move_list moves;
+	u64 divide_nodes[MOVE_LIST_CAPACITY];
+	u64 nodes, start, duration;
+	char move_string[6];
+	u32 i;
+
+	if (!chess_state_from_fen(&c, fen)) {
+		printf("%s: invalid FEN \"%s\"\n", name, fen);
+		*failed = true;
+		return 0;
+	}
+
+	start = time_now_ns();
+	nodes = perft_parallel(&c, o->depth, o->thread_num, &moves, o->divide ? divide_nodes : NULL);
+	duration = time_now_ns() - start;
+	*time_ns += duration;
+
+	if (expected && nodes != expected) {
+		printf("%s depth %u: %" PRIu64 " nodes, FAILED, expected %" PRIu64 "\n", name, o->depth, nodes, expected);
+		*failed = true;
+	}
+	if (o->quiet)
+		return nodes;
+
+	if (o->divide) {
+		for (i = 0; i < moves.size; ++i) {
+			printf("  %-5s %" PRIu64 "\n", move_to_string(moves.moves[i], move_string), divide_nodes[i]);
+		}
+	}
+
+	printf("%-18s depth %u: %12" PRIu64 " nodes %9.3f s %8.2f Mnps", name, o->depth, nodes, duration / 1e9, duration ? nodes * 1e3 / duration : 0.0);
+	if (expected && nodes == expected)
+		printf("  OK");
+	printf("\n");
+	return nodes;
+}
+
+// runs the selected positions, returns the number of counted nodes
+static u64 run_all(const perft_options *o, bool *failed, u64 *time_ns)
+{
+	u64 nodes = 0;
+	u32 i;
+
+	if (o->fen)
+		return run_position(o, "position", o->fen, 0, failed, time_ns);
+
+	for (i = 0; i < perft_position_num; ++i) {
+		nodes += run_position(o, perft_positions[i].name, perft_positions[i].fen,
+			o->depth <= PERFT_MAX_DEPTH ? perft_positions[i].nodes[o->depth - 1] : 0, failed, time_ns);
+	}
+	return nodes;
+}
+
+// repeats the run with doubling thread counts, efficiency is the speedup over one thread divided by the thread count
+static void run_scaling(perft_options *o, bool *failed)
+{
+	u64 nodes, time_ns, base_ns = 0;
+	double speedup;
+
+	o->quiet = true;
+	printf("threads        time         Mnps  speedup  efficiency\n");
+	for (o->thread_num = 1; o->thread_num; o->thread_num = next_thread_num(o->thread_num)) {
+		time_ns = 0;
+		nodes = run_all(o, failed, &time_ns);
+		if (o->thread_num == 1)
+			base_ns = time_ns;
+		speedup = time_ns ? (double) base_ns / time_ns : 0.0;
+		printf("%7u %9.3f s %12.2f %8.2f %10.1f%%\n", o->thread_num, time_ns / 1e9, time_ns ? nodes * 1e3 / time_ns : 0.0,
+			speedup, speedup * 100.0 / o->thread_num);
+	}
+}
+
+// searches every position to a fixed depth with an empty table, per thread count if scaling
+static void run_search(perft_options *o, bool scaling, bool *failed)
+{
+	transposition_table tt;
+	search_result result;
+	chess_state c;
+	u64 nodes, time_ns, depth_ns[SEARCH_MAX_PLY];
+	u32 i, depth, position_num = o->fen ? 1 : perft_position_num;
+
+	if (o->depth >= SEARCH_MAX_PLY || !tt_init(&tt, o->hash_mb)) {
+		*failed = true;
+		return;
+	}
+
+	printf("threads        time         Mnps  time to depth in ms, summed over %u positions\n", position_num);
+	for (o->thread_num = scaling ? 1 : o->thread_num; o->thread_num; o->thread_num = scaling ? next_thread_num(o->thread_num) : 0) {
+		nodes = 0;
+		time_ns = 0;
+		memset(depth_ns, 0, sizeof (depth_ns));
+		for (i = 0; i < position_num; ++i) {
+			if (!chess_state_from_fen(&c, o->fen ? o->fen : perft_positions[i].fen)) {
+				printf("invalid FEN \"%s\"\n", o->fen ? o->fen : perft_positions[i].fen);
+				*failed = true;
+				tt_free(&tt);
+				return;
+			}
+			tt_clear(&tt);
+			search_parallel(&c, NULL, &tt, &(search_limits) { o->depth, 0, 0, NULL }, o->thread_num, &result);
+			nodes += result.nodes;
+			time_ns += result.time_ns;
+			for (depth = 1; depth <= o->depth; ++depth)
+				depth_ns[depth] += result.depth_time_ns[depth];
+		}
+
+		printf("%7u %9.3f s %12.2f ", o->thread_num, time_ns / 1e9, time_ns ? nodes * 1e3 / time_ns : 0.0);
+		for (depth = 1; depth <= o->depth; ++depth)
+			printf(" %u:%.1f", depth, depth_ns[depth] / 1e6);
+		printf("\n");
+	}
+	tt_free(&tt);
+}
+
+static void report_epd_result(const epd_result *r, void *arg)
+{
+	const char *status = !r->valid ? "INVALID" : r->passed ? "OK" : "FAILED";
+	char move_string[6];
+
+	(void) arg;
+	if (!r->valid) {
+		printf("line %6" PRIu64 ": %-7s %s\n", r->line, status, r->text);
+	} else if (r->best_move != MOVE_NONE || !r->expected) {
+		printf("line %6" PRIu64 ": %-7s depth %2u %12" PRIu64 " nodes %9.3f s  best %s\n", r->line, status, r->depth, r->nodes, r->time_ns / 1e9,
+			r->best_move != MOVE_NONE ? move_to_string(r->best_move, move_string) : "-");
+	} else {
+		printf("line %6" PRIu64 ": %-7s depth %2u %12" PRIu64 " nodes %9.3f s  expected %" PRIu64 "\n", r->line, status, r->depth, r->nodes,
+			r->time_ns / 1e9, r->expected);
+	}
+}
+
+// runs a suite file with one position per thread
+static void run_epd(const perft_options *o, bool depth_given, bool *failed)
+{
+	epd_options eo = { o->search ? EPD_BEST_MOVE : EPD_PERFT, o->thread_num, depth_given ? o->depth : 0, o->move_time_ms * 1000000, o->hash_mb };
+	epd_summary s;
+
+	if (o->search && !eo.depth && !eo.time_limit_ns)
+		eo.depth = DEFAULT_SEARCH_DEPTH;
+	if (!epd_run(o->epd, &eo, report_epd_result, NULL, &s)) {
+		printf("Could not run suite %s\n", o->epd);
+		*failed = true;
+		return;
+	}
+	printf("%" PRIu64 " positions: %" PRIu64 " passed, %" PRIu64 " failed, %" PRIu64 " invalid in %.3f s, %.1f positions/s, %.2f Mnps with %u threads\n",
+		s.positions, s.passed, s.failed, s.invalid, s.time_ns / 1e9, s.time_ns ? s.positions * 1e9 / s.time_ns : 0.0,
+		s.time_ns ? s.nodes * 1e3 / s.time_ns : 0.0, o->thread_num);
+	*failed |= s.failed || s.invalid;
+}
+
+static void report_pgn_game(const pgn_game *g, void *arg)
+{
+	static const char *status[] = { "OK", "illegal move", "wrong result", "invalid FEN" };
+
+	(void) arg;
+	printf("game at byte %12" PRIu64 ": %s after %u plies: %s\n", g->offset, status[g->status], g->ply, g->token);
+}
+
+// replays a game collection with the games spread over the threads, optionally building a book from it
+static void run_pgn(const perft_options *o, bool depth_given, bool *failed)
+{
+	pgn_summary s;
+	u64 entry_num;
+
+	if (o->book) {
+		if (!book_build(o->pgn, o->book, depth_given ? o->depth : DEFAULT_BOOK_PLIES, o->thread_num, &entry_num)) {
+			printf("Could not build book %s from %s\n", o->book, o->pgn);
+			*failed = true;
+			return;
+		}
+		printf("Wrote %" PRIu64 " entries to %s\n", entry_num, o->book);
+		return;
+	}
+
+	if (!pgn_replay(o->pgn, o->thread_num, report_pgn_game, NULL, NULL, &s)) {
+		printf("Could not map %s\n", o->pgn);
+		*failed = true;
+		return;
+	}
+	printf("%" PRIu64 " games, %" PRIu64 " plies: %" PRIu64 " illegal, %" PRIu64 " wrong results, %" PRIu64 " invalid in %.3f s, "
+		"%.0f games/s, %.1f MB/s with %u threads\n", s.games, s.plies, s.illegal, s.wrong_result, s.invalid, s.time_ns / 1e9,
+		s.time_ns ? s.games * 1e9 / s.time_ns : 0.0, s.time_ns ? s.bytes * 1e3 / s.time_ns : 0.0, o->thread_num);
+	*failed |= s.illegal || s.wrong_result || s.invalid;
+}
+
+// varies the book choices between games and plies, but repeats them in every run
+static u64 match_random(u32 game, u32 ply)
+{
+	u64 x = ((u64) game << 32 | ply) + 0x9E3779B97F4A7C15ULL;
+
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+// plays games of the engine against itself, the book varies the openings
+static void run_match(const perft_options *o, bool depth_given, bool *failed)
+{
+	search_limits limits = { depth_given ? o->depth : 0, o->move_time_ms * 1000000, 0, NULL };
+	transposition_table tt;
+	opening_book book = { 0 };
+	search_result result;
+	chess_state initial;
+	chess c;
+	u64 wins[COLOR_MAX] = { 0 }, draws = 0, start = time_now_ns(), time_ns;
+	u32 game, book_plies;
+	move m;
+
+	if (!limits.max_depth && !limits.time_limit_ns)
+		limits.time_limit_ns = DEFAULT_MOVE_TIME_MS * 1000000ULL;
+	if (o->book && !book_open(&book, o->book)) {
+		printf("Could not open book %s\n", o->book);
+		*failed = true;
+		return;
+	}
+	if (!tt_init(&tt, o->hash_mb)) {
+		book_close(&book);
+		*failed = true;
+		return;
+	}
+	// games which reach a bitbase endgame are adjudicated instead of played out
+	bitbases_init(BITBASE_FILE, o->thread_num);
+
+	initial = init_chess(&c)->current_state;
+	for (game = 0; game < o->match_games; ++game) {
+		restart_chess(&c, &initial);
+		tt_clear(&tt);
+		for (book_plies = 0; !c.is_game_over && c.record.ply < MATCH_MAX_PLIES;) {
+			// once a game has left the book it stays out
+			m = (book.data && book_plies == c.record.ply) ? book_pick(&book, &c.current_state, match_random(game, c.record.ply)) : MOVE_NONE;
+			if (m != MOVE_NONE) {
+				++book_plies;
+			} else {
+				search_parallel(&c.current_state, &c.positions, &tt, &limits, o->thread_num, &result);
+				m = result.best_move;
+			}
+			play_move(&c, m);
+			if (!c.is_game_over)
+				bitbase_adjudicate(&c);
+		}
+
+		if (c.is_game_over && !c.is_draw)
+			++wins[c.winner];
+		else
+			++draws;
+		printf("game %4u: %-7s after %3u plies, %2u from the book\n", game + 1,
+			!c.is_game_over || c.is_draw ? "1/2-1/2" : c.winner == WHITE ? "1-0" : "0-1", c.record.ply, book_plies);
+	}
+	time_ns = time_now_ns() - start;
+	printf("%u games: white won %" PRIu64 ", black won %" PRIu64 ", %" PRIu64 " draws in %.3f s, %.2f games/s with %u threads\n",
+		o->match_games, wins[WHITE], wins[BLACK], draws, time_ns / 1e9, time_ns ? o->match_games * 1e9 / time_ns : 0.0, o->thread_num);
+
+	free_chess(&c);
+	tt_free(&tt);
+	book_close(&book);
+	bitbases_free();
+}
+
+int main(int argc, char **argv)
+{
+	perft_options o = { 0, 1, NULL, NULL, 0, NULL, NULL, 0, false, false, false, TT_DEFAULT_SIZE_MB };
+	bool scaling = false, failed = false, pext = true, depth_given;
+	const char *trace_path = NULL;
+	u64 nodes, time_ns = 0;
+	int i;
+
+	for (i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "-d") && i + 1 < argc) {
+			o.depth = (u32) strtoul(argv[++i], NULL, 10);
+		} else if (!strcmp(argv[i], "-f") && i + 1 < argc) {
+			o.fen = argv[++i];
+		} else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+			o.thread_num = (u32) strtoul(argv[++i], NULL, 10);
+		} else if (!strcmp(argv[i], "-divide")) {
+			o.divide = true;
+		} else if (!strcmp(argv[i], "-scaling")) {
+			scaling = true;
+		} else if (!strcmp(argv[i], "-search")) {
+			o.search = true;
+		} else if (!strcmp(argv[i], "-hash") && i + 1 < argc) {
+			o.hash_mb = strtoull(argv[++i], NULL, 10);
+		} else if (!strcmp(argv[i], "-nopext")) {
+			pext = false;
+		} else if (!strcmp(argv[i], "-epd") && i + 1 < argc) {
+			o.epd = argv[++i];
+		} else if (!strcmp(argv[i], "-pgn") && i + 1 < argc) {
+			o.pgn = argv[++i];
+		} else if ((!strcmp(argv[i], "-makebook") || !strcmp(argv[i], "-book")) && i + 1 < argc) {
+			o.book = argv[++i];
+		} else if (!strcmp(argv[i], "-match") && i + 1 < argc) {
+			o.match_games = (u32) strtoul(argv[++i], NULL, 10);
+		} else if (!strcmp(argv[i], "-movetime") && i + 1 < argc) {
+			o.move_time_ms = strtoull(argv[++i], NULL, 10);
+		} else if (!strcmp(argv[i], "-profile") && i + 1 < argc) {
+			trace_path = argv[++i];
+		} else {
+			print_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	depth_given = o.depth != 0;
+	if (!o.depth)
+		o.depth = o.search ? DEFAULT_SEARCH_DEPTH : DEFAULT_DEPTH;
+	if (o.thread_num < 1) {
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	attacks_init();
+	printf("slider attacks: %s\n", attacks_set_pext(pext) ? "PEXT" : "magic multiplication");
+
+	if (o.match_games) {
+		run_match(&o, depth_given, &failed);
+	} else if (o.pgn) {
+		run_pgn(&o, depth_given, &failed);
+	} else if (o.epd) {
+		run_epd(&o, depth_given, &failed);
+	} else if (o.search) {
+		run_search(&o, scaling, &failed);
+	} else if (scaling) {
+		run_scaling(&o, &failed);
+	} else {
+		nodes = run_all(&o, &failed, &time_ns);
+		printf("total: %" PRIu64 " nodes in %.3f s, %.2f Mnps with %u threads\n", nodes, time_ns / 1e9,
+			time_ns ? nodes * 1e3 / time_ns : 0.0, o.thread_num);
+	}
+
+	if (trace_path && (!profile_write_json(stdout) || !profile_write_trace(trace_path))) {
+		printf("Could not write the profile, was the program built with PROFILE defined?\n");
+		failed = true;
+	}
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}